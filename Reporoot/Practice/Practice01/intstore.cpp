@@ -0,0 +1,352 @@
+#include "intstore.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../common/ingest.h"
+#include "../common/multiples.h"
+
+namespace {
+
+const uint64_t PAGE = 4096;
+const uint64_t CHUNK_STRIDE = PAGE + IntStore::CHUNK_INTS * sizeof(int);
+
+// Values formatted per parallel task when printing
+const size_t PRINT_SLICE = 1 << 16;
+
+uint64_t chunkOffset(size_t index) {
+    return PAGE + index * CHUNK_STRIDE;
+}
+
+void appendNumber(std::string& out, int num) {
+    char digits[16];
+    out.append(digits, std::to_chars(digits, digits + sizeof(digits), num).ptr);
+    out += ' ';
+}
+
+// Whether [min, max] holds a multiple of value, with 0 a multiple only of 0
+bool rangeHasMultiple(int min, int max, int value) {
+    if (value == 0) return min <= 0 && max >= 0;
+    int64_t d = value < 0 ? -(int64_t)value : value;
+    int64_t low = min;
+    int64_t first = low >= 0 ? (low + d - 1) / d * d : -(-low / d * d);
+    return first <= max;
+}
+
+}
+
+const size_t IntStore::CHUNK_INTS;
+
+IntStore::IntStore() : fd(-1), header(nullptr), fileSize(0), tailIndex(0) {}
+
+IntStore::~IntStore() {
+    unmapChunk(tail);
+    if (header) munmap(header, PAGE);
+    if (fd >= 0) close(fd);
+}
+
+bool IntStore::open(const std::string& file) {
+    fd = ::open(file.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) return false;
+    fileSize = st.st_size;
+    bool fresh = fileSize == 0;
+    if (!fresh && fileSize < PAGE) return false;
+    if (fresh) {
+        if (ftruncate(fd, PAGE) != 0) return false;
+        fileSize = PAGE;
+    }
+    void* base = mmap(nullptr, PAGE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) return false;
+    header = (StoreHeader*)base;
+    if (fresh) {
+        memcpy(header->magic, "INTS", 4);
+        header->version = 1;
+        header->chunkInts = CHUNK_INTS;
+        header->count = 0;
+    }
+    return memcmp(header->magic, "INTS", 4) == 0 && header->version == 1 && header->chunkInts == CHUNK_INTS
+        && fileSize >= chunkOffset(chunkCount());
+}
+
+IntStore::Chunk IntStore::mapChunk(size_t index, bool populate) const {
+    Chunk chunk;
+    int flags = MAP_SHARED | (populate ? MAP_POPULATE : 0);
+    void* base = mmap(nullptr, CHUNK_STRIDE, PROT_READ | PROT_WRITE, flags, fd, chunkOffset(index));
+    if (base == MAP_FAILED) return chunk;
+    chunk.base = base;
+    chunk.summary = (ChunkSummary*)base;
+    chunk.data = (int*)((char*)base + PAGE);
+    uint64_t first = (uint64_t)index * CHUNK_INTS;
+    chunk.count = (size_t)std::min<uint64_t>(CHUNK_INTS, header->count > first ? header->count - first : 0);
+    return chunk;
+}
+
+void IntStore::unmapChunk(Chunk& chunk) const {
+    if (chunk.base) munmap(chunk.base, CHUNK_STRIDE);
+    chunk = Chunk();
+}
+
+// Rebuild a chunk's cached sum, min and max from its values
+void IntStore::summarize(Chunk& chunk) const {
+    ChunkSummary& s = *chunk.summary;
+    if (chunk.count == 0) return;
+    auto range = std::minmax_element(chunk.data, chunk.data + chunk.count);
+    s.sum = (int64_t)reduceSum(chunk.data, chunk.count).value;
+    s.min = *range.first;
+    s.max = *range.second;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    s.valid = 1;
+}
+
+bool IntStore::append(int value) {
+    uint64_t n = header->count;
+    size_t index = n / CHUNK_INTS;
+    size_t offset = n % CHUNK_INTS;
+    if (!tail.base || tailIndex != index) {
+        unmapChunk(tail);
+        uint64_t needed = chunkOffset(index + 1);
+        if (fileSize < needed) {
+            if (ftruncate(fd, needed) != 0) return false;
+            fileSize = needed;
+        }
+        tail = mapChunk(index);
+        tailIndex = index;
+        if (!tail.base) return false;
+    }
+
+    tail.data[offset] = value;
+    // The summary is marked stale until it and the count agree again, so an
+    // append cut short leaves it to be rebuilt rather than counting the
+    // value twice. The fences keep the compiler from moving the stores
+    // across the flag; the mapping sees them in program order.
+    ChunkSummary& s = *tail.summary;
+    bool valid = offset == 0 || s.valid;
+    s.valid = 0;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    if (offset == 0) {
+        s.sum = value;
+        s.min = s.max = value;
+    }
+    else if (valid) {
+        s.sum += value;
+        s.min = std::min(s.min, value);
+        s.max = std::max(s.max, value);
+    }
+    header->count = n + 1;
+    tail.count = offset + 1;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    s.valid = valid;
+    return true;
+}
+
+bool IntStore::load(const std::string& file) {
+    int in = ::open(file.c_str(), O_RDONLY);
+    if (in < 0) return false;
+    bool ok = true;
+    auto add = [&](int value) { ok = ok && append(value); };
+    ok = forEachInteger(in, add) && ok;
+    close(in);
+    return ok;
+}
+
+template <class Skip, class Format>
+bool IntStore::printChunks(std::ostream& out, bool populate, Skip skip, Format format) {
+    size_t chunks = chunkCount();
+    std::vector<std::string> parts;
+    for (size_t c = 0; c < chunks; c++) {
+        Chunk chunk = mapChunk(c, populate);
+        if (!chunk.base) {
+            out << "\n";
+            return false;
+        }
+        if (!skip(chunk)) {
+            parts.assign((chunk.count + PRINT_SLICE - 1) / PRINT_SLICE, std::string());
+            format(chunk, parts);
+            for (const auto& part : parts) out << part;
+        }
+        unmapChunk(chunk);
+    }
+    out << "\n";
+    return true;
+}
+
+bool IntStore::print(std::ostream& out, WorkerPool& pool) {
+    return printChunks(out, true, [](const Chunk&) { return false; }, [&](const Chunk& chunk, std::vector<std::string>& parts) {
+        parallelFor(pool, chunk.count, PRINT_SLICE, [&](size_t begin, size_t end) {
+            std::string& part = parts[begin / PRINT_SLICE];
+            for (size_t i = begin; i < end; i++) appendNumber(part, chunk.data[i]);
+        });
+    });
+}
+
+// A chunk of zeros is left alone. Otherwise the summary is marked stale
+// while the values change, so a Double that is interrupted leaves it to be
+// rebuilt rather than wrong. When the cached range shows doubling cannot
+// overflow, the aggregates are doubled too and marked valid again; chunks
+// that may wrap keep them stale until the next Sum.
+bool IntStore::doubleAll(WorkerPool& pool) {
+    std::atomic<bool> failed(false);
+    parallelFor(pool, chunkCount(), 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            Chunk chunk = mapChunk(c, true);
+            if (!chunk.base) {
+                failed = true;
+                return;
+            }
+            ChunkSummary& s = *chunk.summary;
+            if (!(s.valid && s.min == 0 && s.max == 0)) {
+                bool keep = s.valid && s.min >= INT32_MIN / 2 && s.max <= INT32_MAX / 2;
+                s.valid = 0;
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+                unsigned* values = (unsigned*)chunk.data;
+                for (size_t i = 0; i < chunk.count; i++) values[i] *= 2;
+                if (keep) {
+                    s.sum *= 2;
+                    s.min *= 2;
+                    s.max *= 2;
+                    std::atomic_signal_fence(std::memory_order_seq_cst);
+                    s.valid = 1;
+                }
+            }
+            unmapChunk(chunk);
+        }
+    });
+    return !failed;
+}
+
+// Cached chunk sums are used as they are; other chunks are summed and
+// cached. Chunks are added in order, so the total is the same on any pool.
+bool IntStore::sum(Reduction& total, WorkerPool& pool) {
+    Reduction zero = { 0, false };
+    std::atomic<bool> failed(false);
+    total = parallelReduce(pool, chunkCount(), 1, zero, [&](size_t begin, size_t end) {
+        Reduction part = { 0, false };
+        for (size_t c = begin; c < end; c++) {
+            Chunk chunk = mapChunk(c);
+            if (!chunk.base) {
+                failed = true;
+                break;
+            }
+            if (!chunk.summary->valid) summarize(chunk);
+            part.value += chunk.summary->sum;
+            unmapChunk(chunk);
+        }
+        return part;
+    }, [](Reduction total, Reduction part) { total.value += part.value; return total; });
+    return !failed;
+}
+
+// Chunks whose cached range holds no multiple are skipped without reading
+// their values; the rest go through the reciprocal filter
+bool IntStore::printMultiples(std::ostream& out, int value, WorkerPool& pool) {
+    MultiplesFilter filter({ value });
+    std::vector<std::vector<uint64_t>> bitmaps;
+    auto skip = [&](const Chunk& chunk) {
+        const ChunkSummary& s = *chunk.summary;
+        return chunk.count == 0 || (s.valid && !rangeHasMultiple(s.min, s.max, value));
+    };
+    return printChunks(out, false, skip, [&](const Chunk& chunk, std::vector<std::string>& parts) {
+        filter.match(chunk.data, chunk.count, bitmaps, pool);
+        const std::vector<uint64_t>& hits = bitmaps[0];
+        parallelFor(pool, chunk.count, PRINT_SLICE, [&](size_t begin, size_t end) {
+            std::string& part = parts[begin / PRINT_SLICE];
+            for (size_t w = begin / 64; w < (end + 63) / 64; w++) {
+                for (uint64_t word = hits[w]; word != 0; word &= word - 1) {
+                    appendNumber(part, chunk.data[w * 64 + __builtin_ctzll(word)]);
+                }
+            }
+        });
+    });
+}
+
+void benchmarkStore(size_t count) {
+    const char* file = "bench_store.ints";
+    unlink(file);
+
+    auto seconds = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    auto report = [](const char* name, double vectorTime, double storeTime) {
+        std::cout << std::setw(22) << std::left << name << std::right << std::fixed << std::setprecision(2);
+        if (vectorTime >= 0) std::cout << std::setw(10) << vectorTime * 1000 << " ms";
+        else std::cout << std::setw(13) << "-";
+        std::cout << std::setw(10) << storeTime * 1000 << " ms\n";
+    };
+
+    std::vector<int> values(count);
+    std::mt19937 rng(37);
+    // Positive, so the cached ranges can rule out large divisors
+    for (auto& v : values) v = 1 + (int)(rng() % 2000000);
+
+    std::cout << "store of " << count << " integers in " << IntStore::CHUNK_INTS << "-int chunks\n"
+        << std::setw(22) << std::left << "" << std::right << std::setw(13) << "vector" << std::setw(13) << "store\n";
+    std::ofstream devNull("/dev/null");
+    Reduction vectorSum, storeSum;
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<int> numbers;
+        for (int v : values) numbers.push_back(v);
+        double vectorTime = seconds(start);
+
+        IntStore store;
+        if (!store.open(file)) {
+            std::cerr << "Error: Cannot open store '" << file << "'\n";
+            return;
+        }
+        start = std::chrono::steady_clock::now();
+        for (int v : values) store.append(v);
+        report("add", vectorTime, seconds(start));
+
+        start = std::chrono::steady_clock::now();
+        vectorSum = reduceSum(numbers.data(), numbers.size());
+        vectorTime = seconds(start);
+        start = std::chrono::steady_clock::now();
+        store.sum(storeSum);
+        report("sum (cached)", vectorTime, seconds(start));
+
+        start = std::chrono::steady_clock::now();
+        for (int& num : numbers) num *= 2;
+        vectorTime = seconds(start);
+        start = std::chrono::steady_clock::now();
+        store.doubleAll();
+        report("double", vectorTime, seconds(start));
+
+        start = std::chrono::steady_clock::now();
+        for (int num : numbers) if (num % 7 == 0) devNull << num << " ";
+        devNull << "\n";
+        vectorTime = seconds(start);
+        start = std::chrono::steady_clock::now();
+        store.printMultiples(devNull, 7);
+        report("multiples of 7", vectorTime, seconds(start));
+
+        start = std::chrono::steady_clock::now();
+        for (int num : numbers) if (num % 5000011 == 0) devNull << num << " ";
+        devNull << "\n";
+        vectorTime = seconds(start);
+        start = std::chrono::steady_clock::now();
+        store.printMultiples(devNull, 5000011);
+        report("multiples of 5000011", vectorTime, seconds(start));
+    }
+
+    // The data and the doubled aggregates are still there after reopening
+    auto start = std::chrono::steady_clock::now();
+    IntStore reopened;
+    reopened.open(file);
+    Reduction after;
+    reopened.sum(after);
+    report("reopen and sum", -1, seconds(start));
+    std::cout << "sums " << (storeSum.value == vectorSum.value && after.value == 2 * vectorSum.value ? "match" : "DIFFER")
+        << " the vector, " << reopened.size() << " integers persisted\n";
+    unlink(file);
+}
@@ -0,0 +1,89 @@
+#ifndef INTSTORE_H
+#define INTSTORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include "../common/parallel.h"
+#include "../common/reduce.h"
+
+// File layout: a header page, then chunks that are each a ChunkSummary page
+// followed by CHUNK_INTS ints. Every chunk but the last is full.
+struct StoreHeader {
+    char magic[4];       // "INTS"
+    uint32_t version;
+    uint32_t chunkInts;
+    uint32_t reserved;
+    uint64_t count;
+};
+
+// Cached aggregates of one chunk's values, kept current by Add and Double
+// where that is cheap, and rebuilt by the next Sum where it is not
+struct ChunkSummary {
+    int64_t sum;
+    int32_t min;
+    int32_t max;
+    uint32_t valid;
+    uint32_t reserved;
+};
+
+// Integers kept in a file as fixed-size memory-mapped chunks, so the data
+// survives exit and need not fit in memory. Appends go into the mapped last
+// chunk, growing the file a chunk at a time with nothing copied; other
+// chunks are mapped only while an operation is working on them.
+class IntStore {
+public:
+    static const size_t CHUNK_INTS = 1 << 20;
+
+    IntStore();
+    ~IntStore();
+    IntStore(const IntStore&) = delete;
+    IntStore& operator=(const IntStore&) = delete;
+
+    // Open file, creating an empty store if it does not exist
+    bool open(const std::string& file);
+    uint64_t size() const { return header->count; }
+
+    bool append(int value);
+    // Append the integers in file up to a -1, streamed without holding them
+    bool load(const std::string& file);
+
+    // These return false if a chunk could not be mapped, in which case the
+    // operation stopped part way: the output is cut short, or only some
+    // values were doubled, and total is not the sum
+    bool print(std::ostream& out, WorkerPool& pool = defaultPool());
+    // Doubles every value, wrapping on overflow
+    bool doubleAll(WorkerPool& pool = defaultPool());
+    bool sum(Reduction& total, WorkerPool& pool = defaultPool());
+    bool printMultiples(std::ostream& out, int value, WorkerPool& pool = defaultPool());
+
+private:
+    struct Chunk {
+        void* base = nullptr;
+        ChunkSummary* summary = nullptr;
+        int* data = nullptr;
+        size_t count = 0;
+    };
+
+    int fd;
+    StoreHeader* header;
+    uint64_t fileSize;
+    Chunk tail;
+    size_t tailIndex;
+
+    size_t chunkCount() const { return (size_t)((header->count + CHUNK_INTS - 1) / CHUNK_INTS); }
+    // populate reads the whole chunk in up front, for callers that touch all of it
+    Chunk mapChunk(size_t index, bool populate = false) const;
+    void unmapChunk(Chunk& chunk) const;
+    void summarize(Chunk& chunk) const;
+    // Print chunk by chunk, skipping those skip() rules out and formatting
+    // slices of the rest in parallel
+    template <class Skip, class Format> bool printChunks(std::ostream& out, bool populate, Skip skip, Format format);
+};
+
+// Time appends, cold and cached sums, Double and Multiples on a store of
+// count integers against a std::vector
+void benchmarkStore(size_t count);
+
+#endif
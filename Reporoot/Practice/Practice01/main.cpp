@@ -1,39 +1,200 @@
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
 #include <vector>
+#include "../common/ingest.h"
+#include "../common/multiples.h"
+#include "../common/parallel.h"
+#include "../common/reduce.h"
+#include "intstore.h"
 
-void printVector(const std::vector<int>& vec) {
-    for (int num : vec) std::cout << num << " ";
-    std::cout << "\n";
+// A whole number from the command line, or a usage error
+template <typename T>
+bool parseArgument(const std::string& text, T& value) {
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (result.ec == std::errc() && result.ptr == text.data() + text.size()) return true;
+    std::cerr << "Invalid number '" << text << "'\n";
+    return false;
 }
 
-void doubleVector(std::vector<int>& vec) {
-    for (int& num : vec) num *= 2;
+void doubleVector(std::vector<int>& vec, WorkerPool& pool = defaultPool()) {
+    int* data = vec.data();
+    parallelFor(pool, vec.size(), cacheChunk(sizeof(int)), [data](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) data[i] *= 2;
+    });
 }
 
-int sumVector(const std::vector<int>& vec) {
-    int sum = 0;
-    for (int num : vec) sum += num;
-    return sum;
+// Chunk sums are added in chunk order, so the total is the same on any number of threads
+Reduction sumVector(const std::vector<int>& vec, WorkerPool& pool = defaultPool()) {
+    const int* data = vec.data();
+    Reduction zero = { 0, false };
+    return parallelReduce(pool, vec.size(), cacheChunk(sizeof(int)), zero,
+        [data](size_t begin, size_t end) { return reduceSum(data + begin, end - begin); },
+        [](Reduction total, Reduction part) { total.value += part.value; return total; });
 }
 
-void printMultiples(const std::vector<int>& vec, int value) {
-    for (int num : vec) if (num % value == 0) std::cout << num << " ";
-    std::cout << "\n";
+// The filter marks the multiples in a bitmap, then each chunk formats its
+// own matches into a buffer, and the buffers are printed in chunk order
+void printMultiples(std::ostream& out, const std::vector<int>& vec, int value, WorkerPool& pool = defaultPool()) {
+    std::vector<std::vector<uint64_t>> bitmaps;
+    MultiplesFilter({ value }).match(vec.data(), vec.size(), bitmaps, pool);
+    const std::vector<uint64_t>& hits = bitmaps[0];
+
+    size_t chunk = cacheChunk(sizeof(int)) / 64 * 64;
+    std::vector<std::string> parts((vec.size() + chunk - 1) / chunk);
+    parallelFor(pool, vec.size(), chunk, [&](size_t begin, size_t end) {
+        std::string& part = parts[begin / chunk];
+        char digits[16];
+        for (size_t w = begin / 64; w < (end + 63) / 64; w++) {
+            for (uint64_t word = hits[w]; word != 0; word &= word - 1) {
+                int num = vec[w * 64 + __builtin_ctzll(word)];
+                part.append(digits, std::to_chars(digits, digits + sizeof(digits), num).ptr);
+                part += ' ';
+            }
+        }
+    });
+    for (const auto& part : parts) out << part;
+    out << "\n";
 }
 
-int main() {
-    std::vector<int> numbers;
+// Time the three vector operations on 1 to N threads for 10^6 elements up
+// to maxCount, and check every thread count gives the same answers
+void benchmarkScaling(size_t maxCount) {
+    std::vector<unsigned> threads;
+    for (unsigned t = 1; t <= std::max(4u, std::thread::hardware_concurrency()); t *= 2) threads.push_back(t);
+
+    auto seconds = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::cout << "scaling on " << std::thread::hardware_concurrency() << " hardware threads, chunks of "
+        << cacheChunk(sizeof(int)) << " ints\n"
+        << std::setw(12) << "elements" << std::setw(9) << "threads" << std::setw(12) << "double ms"
+        << std::setw(12) << "sum ms" << std::setw(14) << "multiples ms" << "  speedup (double/sum/multiples)\n";
+
+    for (size_t count = 1000000; count <= maxCount; count *= 10) {
+        std::vector<int> numbers;
+        try {
+            numbers.resize(count);
+        }
+        catch (const std::bad_alloc&) {
+            std::cout << std::setw(12) << count << "  skipped, not enough memory\n";
+            break;
+        }
+        // Small values, so doubling once per thread count cannot overflow
+        std::mt19937 rng(29);
+        for (auto& v : numbers) v = (int)(rng() % 2000001) - 1000000;
+
+        std::ofstream devNull("/dev/null");
+        double base[3] = {};
+        Reduction firstSum = { 0, false };
+        bool same = true;
+        for (unsigned t : threads) {
+            WorkerPool pool(t);
+
+            auto start = std::chrono::steady_clock::now();
+            Reduction sum = sumVector(numbers, pool);
+            double sumTime = seconds(start);
+            if (t == 1) firstSum = sum;
+            same = same && sum.value == firstSum.value;
+
+            start = std::chrono::steady_clock::now();
+            printMultiples(devNull, numbers, 7, pool);
+            double multiplesTime = seconds(start);
+
+            start = std::chrono::steady_clock::now();
+            doubleVector(numbers, pool);
+            double doubleTime = seconds(start);
+            firstSum.value *= 2;
+
+            double times[3] = { doubleTime, sumTime, multiplesTime };
+            if (t == 1) std::copy(times, times + 3, base);
+            std::cout << std::setw(12) << count << std::setw(9) << t << std::fixed << std::setprecision(2)
+                << std::setw(12) << doubleTime * 1000 << std::setw(12) << sumTime * 1000 << std::setw(14)
+                << multiplesTime * 1000 << "  " << std::setprecision(1) << base[0] / doubleTime << "x / "
+                << base[1] / sumTime << "x / " << base[2] / multiplesTime << "x\n";
+        }
+        std::cout << std::setw(12) << count << "  sums " << (same ? "identical" : "DIFFER") << " across thread counts\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        size_t count = 100000000;
+        if (argc > 2 && !parseArgument(argv[2], count)) {
+            return 1;
+        }
+        benchmarkIngest(count);
+        benchmarkReductions(count);
+        benchmarkMultiples(count / 10);
+        benchmarkStore(count);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--scaling") {
+        size_t maxCount = 1000000000;
+        if (argc > 2 && !parseArgument(argv[2], maxCount)) {
+            return 1;
+        }
+        benchmarkScaling(maxCount);
+        return 0;
+    }
+
+    // --store FILE picks the file the numbers live in; --load FILE appends
+    // the integers in FILE, up to a -1, before the menu starts
+    std::string storeFile = "numbers.store";
+    std::string loadFile;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--store") storeFile = argv[i + 1];
+        else if (option == "--load") loadFile = argv[i + 1];
+    }
+    IntStore numbers;
+    if (!numbers.open(storeFile)) {
+        std::cerr << "Error: Cannot open store '" << storeFile << "'\n";
+        return 1;
+    }
+    if (!loadFile.empty() && !numbers.load(loadFile)) {
+        std::cerr << "Error: Cannot read file '" << loadFile << "'\n";
+        return 1;
+    }
+
     int choice, num;
 
     while (true) {
         std::cout << "1. Add\n2. Print\n3. Double\n4. Sum\n5. Multiples\n6. Exit\nChoice: ";
         std::cin >> choice;
 
-        if (choice == 1) { std::cin >> num; numbers.push_back(num); }
-        else if (choice == 2) printVector(numbers);
-        else if (choice == 3) doubleVector(numbers);
-        else if (choice == 4) std::cout << sumVector(numbers) << "\n";
-        else if (choice == 5) { std::cin >> num; printMultiples(numbers, num); }
+        if (choice == 1) {
+            std::cin >> num;
+            if (!numbers.append(num)) std::cerr << "Error: Cannot add to store '" << storeFile << "'\n";
+        }
+        else if (choice == 2) {
+            if (!numbers.print(std::cout)) {
+                std::cerr << "Error: Cannot read store '" << storeFile << "', list cut short\n";
+            }
+        }
+        else if (choice == 3) {
+            if (!numbers.doubleAll()) {
+                std::cerr << "Error: Cannot read store '" << storeFile << "', only some values were doubled\n";
+            }
+        }
+        else if (choice == 4) {
+            Reduction total;
+            if (numbers.sum(total)) std::cout << total << "\n";
+            else std::cerr << "Error: Cannot read store '" << storeFile << "'\n";
+        }
+        else if (choice == 5) {
+            std::cin >> num;
+            if (!numbers.printMultiples(std::cout, num)) {
+                std::cerr << "Error: Cannot read store '" << storeFile << "', list cut short\n";
+            }
+        }
         else if (choice == 6) break;
         else std::cout << "Invalid choice\n";
     }
@@ -0,0 +1,109 @@
+#ifndef AUDIT_H
+#define AUDIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "money.h"
+#include "txlog.h"
+
+struct AuditRecord {
+    int64_t time;  // seconds since the epoch
+    uint64_t account;
+    Money amount;
+    RecordType type;
+};
+
+// Appends transaction history as immutable partition files, one per time
+// span and at most maxRecords records each. Each partition stores its
+// records as separate columns (time, account, amount, type) sorted by time,
+// behind a header with min/max values and a bloom filter over the account IDs.
+//
+// The live history keeps records that are not in a partition yet in a
+// journal file in the directory; commit() makes them durable there, and
+// later runs carry on with the same journal until the partition fills or the
+// span moves on. A named writer keeps no journal. Its partitions are named
+// after it and numbered in order, and a partition whose name already exists
+// is left alone, so writing the same records again under the same name adds
+// nothing.
+class HistoryWriter {
+private:
+    std::string dir;
+    std::string name;  // empty for the live history
+    int64_t span;
+    size_t maxRecords;
+    int64_t partitionStart;
+    int part;          // number of the live partition being collected, -1 until chosen
+    int written;       // partitions named after a named writer so far
+    std::vector<int64_t> times;
+    std::vector<uint64_t> accounts;
+    std::vector<int64_t> amounts;
+    std::vector<uint8_t> types;
+    int journal;       // -1 for a named writer
+    size_t journaled;  // records already in the journal
+
+    void openJournal();
+
+public:
+    explicit HistoryWriter(const std::string& dir, int64_t partitionSeconds = 86400, size_t maxRecords = 1 << 16);
+    HistoryWriter(const std::string& dir, const std::string& name, int64_t partitionSeconds = 86400,
+        size_t maxRecords = 1 << 16);
+    // Commits the live history, flushes a named writer
+    ~HistoryWriter();
+    HistoryWriter(const HistoryWriter&) = delete;
+    HistoryWriter& operator=(const HistoryWriter&) = delete;
+
+    bool append(const AuditRecord& record);
+
+    // Make the live history appended so far durable in the journal
+    bool commit();
+
+    // Write out the open partition, if it has anything in it
+    bool flush();
+};
+
+struct AuditQuery {
+    int64_t fromTime = INT64_MIN;  // inclusive
+    int64_t toTime = INT64_MAX;    // exclusive
+    uint64_t account = 0;          // 0 matches every account
+    uint8_t type = 0;              // 0 matches deposits and withdrawals
+    Money minAmount = Money(INT64_MIN);
+    Money maxAmount = Money(INT64_MAX);
+};
+
+struct QueryStats {
+    size_t partitions = 0;
+    size_t skipped = 0;  // ruled out by the min/max index or the bloom filter
+    size_t scanned = 0;  // rows actually compared
+    size_t matches = 0;
+};
+
+// Read side of the history: every partition in the directory, memory-mapped,
+// and the live records still in the journal
+class HistoryStore {
+private:
+    struct Partition;
+    std::vector<Partition*> partitions;
+
+public:
+    HistoryStore() {}
+    ~HistoryStore();
+    HistoryStore(const HistoryStore&) = delete;
+    HistoryStore& operator=(const HistoryStore&) = delete;
+
+    // Map every partition in dir and load the journal, returns false if the
+    // directory can't be read
+    bool open(const std::string& dir);
+
+    size_t partitionCount() const { return partitions.size(); }
+
+    // Collect matching records in time order. With useIndex false every row of
+    // every partition is checked, which is what the index is measured against.
+    QueryStats query(const AuditQuery& q, std::vector<AuditRecord>& out, bool useIndex = true) const;
+};
+
+// Write count synthetic records spread over a year and time some audit queries
+void benchmarkAudit(size_t count);
+
+#endif
@@ -0,0 +1,153 @@
+#include "batch.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+const size_t CHUNK = 64;
+
+// Checked scalar posting used whenever the fast path can't be proven safe
+inline bool postOne(int64_t& balance, int64_t amount) {
+    int64_t next;
+    if (__builtin_add_overflow(balance, amount, &next) || next < 0) return false;
+    balance = next;
+    return true;
+}
+
+
+// A deposit or withdrawal of 1 to MAX_POSTING_CENTS cents, as PostingBatch::add accepts
+inline bool validPosting(int64_t amount) {
+    return amount != 0 && (uint64_t)amount + MAX_POSTING_CENTS <= 2 * (uint64_t)MAX_POSTING_CENTS;
+}
+
+}
+
+bool PostingBatch::add(uint64_t account, RecordType type, Money amount) {
+    int64_t cents = amount.toCents();
+    if (cents <= 0 || cents > MAX_POSTING_CENTS) return false;
+    accounts.push_back(account);
+    amounts.push_back(type == REC_DEPOSIT ? cents : -cents);
+    return true;
+}
+
+void PostingBatch::clear() {
+    accounts.clear();
+    amounts.clear();
+}
+
+BatchSummary postBatch(Ledger& ledger, const PostingBatch& batch, uint8_t* accepted) {
+    size_t n = batch.size();
+    const uint64_t* accounts = batch.accounts.data();
+    const int64_t* amounts = batch.amounts.data();
+
+    // Open every deposit target first so the table can't grow while we hold slot pointers
+    for (size_t i = 0; i < n; i++) {
+        if (amounts[i] > 0) ledger.open(accounts[i], Money());
+    }
+    std::vector<Money*> targets(n);
+    for (size_t i = 0; i < n; i++) {
+        targets[i] = ledger.find(accounts[i]);
+    }
+
+    // Balance may never go below zero, which is the withdraw rule from the menu
+    BatchSummary summary;
+    for (size_t i = 0; i < n; i++) {
+        bool ok = false;
+        if (targets[i]) {
+            int64_t cents = targets[i]->toCents();
+            ok = postOne(cents, amounts[i]);
+            *targets[i] = Money(cents);
+        }
+        summary.applied += ok;
+        if (accepted) accepted[i] = ok;
+    }
+    summary.rejected = n - summary.applied;
+    return summary;
+}
+
+BatchSummary postBatch(Money& balance, const int64_t* amounts, size_t count) {
+    const int64_t fastLimit = LLONG_MAX - (int64_t)CHUNK * MAX_POSTING_CENTS;
+    int64_t cents = balance.toCents();
+    BatchSummary summary;
+
+    for (size_t i = 0; i < count; i += CHUNK) {
+        size_t len = std::min(CHUNK, count - i);
+        const int64_t* a = amounts + i;
+
+        // If every amount is in range and the balance covers every withdrawal
+        // in the chunk, none can be refused. The sums wrap rather than
+        // overflow while an amount may be out of range, and are exact once
+        // none is.
+        uint64_t withdrawals = 0, total = 0;
+        bool valid = true;
+        for (size_t k = 0; k < len; k++) {
+            valid &= validPosting(a[k]);
+            withdrawals += a[k] < 0 ? (uint64_t)a[k] : 0;
+            total += (uint64_t)a[k];
+        }
+        if (valid && cents + (int64_t)withdrawals >= 0 && cents <= fastLimit) {
+            cents += (int64_t)total;
+            summary.applied += len;
+            continue;
+        }
+
+        for (size_t k = 0; k < len; k++) {
+            summary.applied += validPosting(a[k]) && postOne(cents, a[k]);
+        }
+    }
+
+    balance = Money(cents);
+    summary.rejected = count - summary.applied;
+    return summary;
+}
+
+void benchmarkBatchPosting(size_t count) {
+    std::mt19937_64 rng(7);
+    std::vector<int64_t> amounts(count);
+    std::vector<double> dollars(count);
+    for (size_t i = 0; i < count; i++) {
+        amounts[i] = (rng() % 2) ? (int64_t)(1 + rng() % 10000) : -(int64_t)(1 + rng() % 9000);
+        dollars[i] = amounts[i] / 100.0;
+    }
+
+    auto report = [&](const char* name, std::chrono::steady_clock::time_point start, const std::string& result) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << std::setw(22) << std::left << name << std::right << std::fixed << std::setprecision(1)
+            << count / seconds / 1e6 << " Mtx/s  " << result << "\n";
+    };
+
+    // The original program: double balance, withdrawal refused if larger than the balance
+    auto start = std::chrono::steady_clock::now();
+    double balance = 100.00;
+    for (size_t i = 0; i < count; i++) {
+        if (dollars[i] > 0) balance += dollars[i];
+        else if (-dollars[i] <= balance) balance += dollars[i];
+    }
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(2) << balance;
+    report("double", start, "final $" + text.str());
+
+    start = std::chrono::steady_clock::now();
+    int64_t cents = 10000;
+    for (size_t i = 0; i < count; i++) postOne(cents, amounts[i]);
+    report("Money scalar", start, "final $" + Money(cents).toString());
+
+    start = std::chrono::steady_clock::now();
+    Money single(10000);
+    postBatch(single, amounts.data(), count);
+    report("Money batch", start, "final $" + single.toString());
+
+    PostingBatch batch;
+    for (size_t i = 0; i < count; i++) {
+        batch.add(1 + rng() % 100000, amounts[i] > 0 ? REC_DEPOSIT : REC_WITHDRAW, Money(std::abs(amounts[i])));
+    }
+    Ledger ledger;
+    start = std::chrono::steady_clock::now();
+    BatchSummary summary = postBatch(ledger, batch);
+    report("ledger batch (100k)", start, std::to_string(summary.applied) + " applied");
+}
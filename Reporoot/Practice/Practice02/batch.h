@@ -0,0 +1,43 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ledger.h"
+#include "txlog.h"
+
+// Largest single posting accepted into a batch (10 trillion dollars), which
+// lets the fast path add up a whole chunk without overflow checks
+const int64_t MAX_POSTING_CENTS = 1000000000000000LL;
+
+// Deposits and withdrawals as two flat columns; withdrawals are stored negative
+struct PostingBatch {
+    std::vector<uint64_t> accounts;
+    std::vector<int64_t> amounts;
+
+    // Returns false for a non-positive or oversized amount
+    bool add(uint64_t account, RecordType type, Money amount);
+    size_t size() const { return amounts.size(); }
+    void clear();
+};
+
+struct BatchSummary {
+    size_t applied = 0;
+    size_t rejected = 0;  // insufficient funds, unknown account or overflow
+};
+
+// Apply every posting in order with the menu's rules. accepted, if given,
+// gets one 0/1 entry per posting.
+BatchSummary postBatch(Ledger& ledger, const PostingBatch& batch, uint8_t* accepted = nullptr);
+
+// Same for postings that all go to one balance, given as signed cents.
+// Chunks where the balance covers every withdrawal are summed with a
+// vectorizable loop. An amount of zero or beyond MAX_POSTING_CENTS either
+// way is refused.
+BatchSummary postBatch(Money& balance, const int64_t* amounts, size_t count);
+
+// Print posting throughput for the double, Money and batched paths
+void benchmarkBatchPosting(size_t count);
+
+#endif
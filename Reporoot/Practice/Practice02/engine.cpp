@@ -0,0 +1,175 @@
+#include "engine.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <thread>
+
+namespace {
+
+Money atomicLoad(const Money* balance) {
+    Money value;
+    __atomic_load(balance, &value, __ATOMIC_ACQUIRE);
+    return value;
+}
+
+// On failure expected is refreshed with the current balance
+bool atomicSwap(Money* balance, Money& expected, Money desired) {
+    return __atomic_compare_exchange(balance, &expected, &desired, true,
+        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+TxResult casAdd(Money* balance, Money amount) {
+    Money current = atomicLoad(balance);
+    Money next;
+    do {
+        if (!checkedAdd(current, amount, next)) return TX_OVERFLOW;
+    } while (!atomicSwap(balance, current, next));
+    return TX_OK;
+}
+
+TxResult casSubtract(Money* balance, Money amount) {
+    Money current = atomicLoad(balance);
+    Money next;
+    do {
+        if (amount > current) return TX_INSUFFICIENT;
+        checkedSub(current, amount, next);
+    } while (!atomicSwap(balance, current, next));
+    return TX_OK;
+}
+
+}
+
+TransferEngine::TransferEngine(Ledger& ledger, ConcurrencyMode mode)
+    : ledger(ledger), mode(mode), stripes(STRIPES) {}
+
+TxResult TransferEngine::deposit(uint64_t account, Money amount) {
+    if (amount <= Money()) return TX_INVALID;
+    Money* balance = ledger.find(account);
+    if (!balance) return TX_NO_ACCOUNT;
+
+    if (mode == CONCURRENCY_CAS) return casAdd(balance, amount);
+
+    std::lock_guard<std::mutex> guard(stripes[stripeOf(account)].lock);
+    return checkedAdd(*balance, amount, *balance) ? TX_OK : TX_OVERFLOW;
+}
+
+TxResult TransferEngine::withdraw(uint64_t account, Money amount) {
+    if (amount <= Money()) return TX_INVALID;
+    Money* balance = ledger.find(account);
+    if (!balance) return TX_NO_ACCOUNT;
+
+    if (mode == CONCURRENCY_CAS) return casSubtract(balance, amount);
+
+    std::lock_guard<std::mutex> guard(stripes[stripeOf(account)].lock);
+    if (amount > *balance) return TX_INSUFFICIENT;
+    checkedSub(*balance, amount, *balance);
+    return TX_OK;
+}
+
+TxResult TransferEngine::transfer(uint64_t from, uint64_t to, Money amount) {
+    if (amount <= Money() || from == to) return TX_INVALID;
+    Money* source = ledger.find(from);
+    Money* target = ledger.find(to);
+    if (!source || !target) return TX_NO_ACCOUNT;
+
+    if (mode == CONCURRENCY_CAS) {
+        TxResult result = casSubtract(source, amount);
+        if (result != TX_OK) return result;
+        result = casAdd(target, amount);
+        if (result != TX_OK) {
+            // Hand the money back; retry until any deposit racing us on source settles
+            while (casAdd(source, amount) != TX_OK) std::this_thread::yield();
+        }
+        return result;
+    }
+
+    // Always lock the lower stripe first so two opposite transfers can't deadlock
+    size_t first = stripeOf(from), second = stripeOf(to);
+    if (first > second) std::swap(first, second);
+    std::unique_lock<std::mutex> lockFirst(stripes[first].lock);
+    std::unique_lock<std::mutex> lockSecond;
+    if (second != first) lockSecond = std::unique_lock<std::mutex>(stripes[second].lock);
+
+    Money debited, credited;
+    if (amount > *source) return TX_INSUFFICIENT;
+    checkedSub(*source, amount, debited);
+    if (!checkedAdd(*target, amount, credited)) return TX_OVERFLOW;
+    *source = debited;
+    *target = credited;
+    return TX_OK;
+}
+
+bool TransferEngine::balance(uint64_t account, Money& out) const {
+    const Money* balance = ledger.find(account);
+    if (!balance) return false;
+
+    if (mode == CONCURRENCY_CAS) {
+        out = atomicLoad(balance);
+        return true;
+    }
+
+    std::lock_guard<std::mutex> guard(stripes[stripeOf(account)].lock);
+    out = *balance;
+    return true;
+}
+
+void benchmarkTransfers(size_t accounts, size_t opsPerThread, unsigned maxThreads) {
+    const char* names[] = { "striped", "cas" };
+    ConcurrencyMode modes[] = { CONCURRENCY_STRIPED, CONCURRENCY_CAS };
+    const Money opening(100000);  // $1000.00 per account
+
+    for (int m = 0; m < 2; m++) {
+        for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+            Ledger ledger(accounts * 2);
+            for (uint64_t id = 1; id <= accounts; id++) ledger.open(id, opening);
+            TransferEngine engine(ledger, modes[m]);
+
+            // Net cents each thread added through deposits and withdrawals
+            std::vector<int64_t> net(threads, 0);
+            std::vector<std::thread> workers;
+
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned t = 0; t < threads; t++) {
+                workers.emplace_back([&, t]() {
+                    std::mt19937_64 rng(1000 + t);
+                    for (size_t i = 0; i < opsPerThread; i++) {
+                        uint64_t a = 1 + rng() % accounts;
+                        uint64_t b = 1 + rng() % accounts;
+                        Money amount(1 + rng() % 50000);
+                        unsigned kind = rng() % 10;
+                        if (kind == 0) {
+                            if (engine.deposit(a, amount) == TX_OK) net[t] += amount.toCents();
+                        }
+                        else if (kind == 1) {
+                            if (engine.withdraw(a, amount) == TX_OK) net[t] -= amount.toCents();
+                        }
+                        else {
+                            engine.transfer(a, b, amount);
+                        }
+                    }
+                });
+            }
+            for (auto& w : workers) w.join();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            // Every balance must be non-negative and the total must match the opening total plus net flow
+            int64_t expected = opening.toCents() * (int64_t)accounts;
+            for (int64_t n : net) expected += n;
+            int64_t total = 0;
+            bool overdrawn = false;
+            for (uint64_t id = 1; id <= accounts; id++) {
+                Money balance;
+                engine.balance(id, balance);
+                total += balance.toCents();
+                overdrawn = overdrawn || balance < Money();
+            }
+
+            std::cout << std::setw(8) << std::left << names[m] << std::right
+                << std::setw(3) << threads << " threads  "
+                << std::fixed << std::setprecision(2)
+                << threads * opsPerThread / seconds / 1e6 << " Mtx/s  "
+                << (total == expected && !overdrawn ? "conserved" : "MISMATCH") << "\n";
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "ledger.h"
+
+enum ConcurrencyMode {
+    CONCURRENCY_STRIPED,  // one mutex per stripe of accounts, taken in stripe order
+    CONCURRENCY_CAS       // compare-and-swap on each balance, no locks
+};
+
+enum TxResult {
+    TX_OK,
+    TX_NO_ACCOUNT,
+    TX_INSUFFICIENT,
+    TX_OVERFLOW,
+    TX_INVALID
+};
+
+// Lets many threads post deposits, withdrawals and transfers against one
+// ledger while keeping the no-overdraft rule. Accounts must be opened before
+// threads start using the engine; the table is never resized underneath them.
+class TransferEngine {
+private:
+    struct alignas(64) Stripe {
+        std::mutex lock;
+    };
+
+    static const size_t STRIPES = 1024;
+
+    Ledger& ledger;
+    ConcurrencyMode mode;
+    mutable std::vector<Stripe> stripes;
+
+    size_t stripeOf(uint64_t account) const { return account & (STRIPES - 1); }
+
+public:
+    TransferEngine(Ledger& ledger, ConcurrencyMode mode);
+
+    TxResult deposit(uint64_t account, Money amount);
+    TxResult withdraw(uint64_t account, Money amount);
+
+    // Move amount between two accounts. Under CAS the money leaves from before
+    // it reaches to, so the total only adds up once no transfer is in flight.
+    TxResult transfer(uint64_t from, uint64_t to, Money amount);
+
+    // Read one balance, returns false if the account does not exist
+    bool balance(uint64_t account, Money& out) const;
+};
+
+// Hammer the engine from 1..maxThreads threads in each mode, print throughput
+// and check that money is conserved
+void benchmarkTransfers(size_t accounts, size_t opsPerThread, unsigned maxThreads);
+
+#endif
@@ -0,0 +1,248 @@
+#include "ledger.h"
+#include "../common/crc32.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+const uint32_t SNAPSHOT_MAGIC = 0x5244474C;  // "LGDR"
+const uint32_t SNAPSHOT_VERSION = 2;  // 2: balances in integer cents
+const size_t HEADER_SIZE = 64;               // keeps the slot array cache-line aligned
+
+struct SnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    uint64_t count;
+    uint64_t seq;
+    uint32_t crc;  // over the fields above
+};
+
+uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+AccountSlot* allocateSlots(size_t capacity) {
+    AccountSlot* slots = new AccountSlot[capacity];
+    for (size_t i = 0; i < capacity; i++) {
+        slots[i].id = Ledger::EMPTY_ID;
+        slots[i].balance = Money();
+    }
+    return slots;
+}
+
+uint32_t headerCrc(const SnapshotHeader& h) {
+    return crc32(reinterpret_cast<const unsigned char*>(&h), offsetof(SnapshotHeader, crc));
+}
+
+bool writeAll(int fd, const void* data, size_t len) {
+    const char* p = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+}
+
+Ledger::Ledger(size_t initialCapacity)
+    : slots(nullptr), capacity(16), count(0), mapping(nullptr), mappingSize(0) {
+    while (capacity < initialCapacity) capacity *= 2;
+    slots = allocateSlots(capacity);
+}
+
+Ledger::~Ledger() {
+    release();
+}
+
+void Ledger::release() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+    }
+    else {
+        delete[] slots;
+    }
+    slots = nullptr;
+}
+
+size_t Ledger::probe(uint64_t id) const {
+    size_t mask = capacity - 1;
+    size_t i = mix(id) & mask;
+    while (slots[i].id != id && slots[i].id != EMPTY_ID)
+        i = (i + 1) & mask;
+    return i;
+}
+
+void Ledger::grow() {
+    size_t oldCapacity = capacity;
+    AccountSlot* old = slots;
+    void* oldMapping = mapping;
+
+    capacity *= 2;
+    slots = allocateSlots(capacity);
+    for (size_t i = 0; i < oldCapacity; i++) {
+        if (old[i].id != EMPTY_ID)
+            slots[probe(old[i].id)] = old[i];
+    }
+
+    if (oldMapping) {
+        munmap(oldMapping, mappingSize);
+        mapping = nullptr;
+    }
+    else {
+        delete[] old;
+    }
+}
+
+Money* Ledger::find(uint64_t id) {
+    size_t i = probe(id);
+    return slots[i].id == id ? &slots[i].balance : nullptr;
+}
+
+const Money* Ledger::find(uint64_t id) const {
+    size_t i = probe(id);
+    return slots[i].id == id ? &slots[i].balance : nullptr;
+}
+
+Money& Ledger::open(uint64_t id, Money openingBalance) {
+    size_t i = probe(id);
+    if (slots[i].id == id) return slots[i].balance;
+
+    // Keep the load factor under 0.7 so probe runs stay short
+    if ((count + 1) * 10 > capacity * 7) {
+        grow();
+        i = probe(id);
+    }
+    slots[i].id = id;
+    slots[i].balance = openingBalance;
+    count++;
+    return slots[i].balance;
+}
+
+bool Ledger::deposit(uint64_t id, Money amount) {
+    Money& balance = open(id, Money());
+    return checkedAdd(balance, amount, balance);
+}
+
+bool Ledger::withdraw(uint64_t id, Money amount) {
+    Money* balance = find(id);
+    if (!balance || amount > *balance) return false;
+    return checkedSub(*balance, amount, *balance);
+}
+
+bool Ledger::saveSnapshot(const std::string& file, uint64_t seq) const {
+    unsigned char header[HEADER_SIZE] = {};
+    SnapshotHeader h = {};
+    h.magic = SNAPSHOT_MAGIC;
+    h.version = SNAPSHOT_VERSION;
+    h.capacity = capacity;
+    h.count = count;
+    h.seq = seq;
+    h.crc = headerCrc(h);
+    memcpy(header, &h, sizeof(h));
+
+    std::string tmp = file + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool ok = writeAll(fd, header, HEADER_SIZE)
+        && writeAll(fd, slots, capacity * sizeof(AccountSlot))
+        && fsync(fd) == 0;
+    close(fd);
+    if (!ok) return false;
+    return rename(tmp.c_str(), file.c_str()) == 0;
+}
+
+bool Ledger::loadSnapshot(const std::string& file, uint64_t& seq) {
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    SnapshotHeader h;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < HEADER_SIZE
+        || pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)
+        || h.magic != SNAPSHOT_MAGIC || h.version != SNAPSHOT_VERSION || h.crc != headerCrc(h)
+        || h.capacity == 0 || (h.capacity & (h.capacity - 1)) != 0
+        || (size_t)st.st_size != HEADER_SIZE + h.capacity * sizeof(AccountSlot)) {
+        close(fd);
+        return false;
+    }
+
+    // Private mapping: pages are shared with the page cache until the first write to them
+    void* m = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) return false;
+
+    // Only the header is checksummed, so check the slots against it. probe()
+    // relies on an empty slot to end every miss, which the load factor
+    // open() keeps under 0.7 guarantees.
+    const AccountSlot* loaded = reinterpret_cast<const AccountSlot*>(static_cast<char*>(m) + HEADER_SIZE);
+    uint64_t used = 0;
+    for (size_t i = 0; i < h.capacity; i++) {
+        if (loaded[i].id != EMPTY_ID) used++;
+    }
+    if (used != h.count || used * 10 > h.capacity * 7) {
+        munmap(m, st.st_size);
+        return false;
+    }
+
+    release();
+    mapping = m;
+    mappingSize = st.st_size;
+    slots = reinterpret_cast<AccountSlot*>(static_cast<char*>(m) + HEADER_SIZE);
+    capacity = h.capacity;
+    count = h.count;
+    seq = h.seq;
+    return true;
+}
+
+void benchmarkLedger(size_t accounts, size_t operations) {
+    std::mt19937_64 rng(42);
+    std::vector<uint64_t> ids(operations);
+    for (auto& id : ids) id = 1 + rng() % accounts;
+
+    Ledger ledger;
+    for (uint64_t id = 1; id <= accounts; id++) ledger.open(id, Money(10000));
+
+    auto measure = [&](const char* name, auto op) {
+        auto start = std::chrono::steady_clock::now();
+        volatile int64_t sink = 0;
+        for (size_t i = 0; i < operations; i++) sink = sink + op(ids[i]);
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() / operations;
+        std::cout << std::setw(10) << std::left << name << std::right
+            << std::fixed << std::setprecision(1) << ns << " ns/op\n";
+    };
+
+    std::cout << accounts << " accounts, " << operations << " operations\n";
+    measure("deposit", [&](uint64_t id) { return ledger.deposit(id, Money(100)) ? 1 : 0; });
+    measure("withdraw", [&](uint64_t id) { return ledger.withdraw(id, Money(50)) ? 1 : 0; });
+    measure("balance", [&](uint64_t id) { return ledger.find(id)->toCents(); });
+
+    auto start = std::chrono::steady_clock::now();
+    ledger.saveSnapshot("bench_ledger.snap", 0);
+    auto mid = std::chrono::steady_clock::now();
+    Ledger loaded;
+    uint64_t seq;
+    loaded.loadSnapshot("bench_ledger.snap", seq);
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "snapshot save " << std::chrono::duration<double, std::milli>(mid - start).count()
+        << " ms, load " << std::chrono::duration<double, std::milli>(end - mid).count() << " ms\n";
+    unlink("bench_ledger.snap");
+}
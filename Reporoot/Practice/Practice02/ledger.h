@@ -0,0 +1,65 @@
+#ifndef LEDGER_H
+#define LEDGER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "money.h"
+
+// One slot of the hash table, also the on-disk layout of the snapshot
+struct AccountSlot {
+    uint64_t id;
+    Money balance;
+};
+
+// Balances for many accounts keyed by account ID. Open addressing with linear
+// probing over one flat array, so a lookup touches one or two cache lines.
+// Snapshots are the raw array behind a small header and are memory-mapped on
+// load instead of parsed.
+class Ledger {
+private:
+    AccountSlot* slots;
+    size_t capacity;  // always a power of two
+    size_t count;
+    void* mapping;    // non-null while slots point into a mapped snapshot
+    size_t mappingSize;
+
+    size_t probe(uint64_t id) const;
+    void grow();
+    void release();
+
+public:
+    static const uint64_t EMPTY_ID = ~0ULL;
+
+    explicit Ledger(size_t initialCapacity = 1024);
+    ~Ledger();
+    Ledger(const Ledger&) = delete;
+    Ledger& operator=(const Ledger&) = delete;
+
+    // Returns a pointer to the balance, or nullptr if the account does not exist
+    Money* find(uint64_t id);
+    const Money* find(uint64_t id) const;
+
+    // Returns the balance, opening the account with openingBalance if needed
+    Money& open(uint64_t id, Money openingBalance);
+
+    // Returns false and leaves the balance alone if it would overflow
+    bool deposit(uint64_t id, Money amount);
+
+    // Returns false and leaves the balance alone if the account is missing or short of funds
+    bool withdraw(uint64_t id, Money amount);
+
+    size_t size() const { return count; }
+
+    // Write the table to file (via a temp file and rename), tagged with the log sequence it covers
+    bool saveSnapshot(const std::string& file, uint64_t seq) const;
+
+    // Map a snapshot written by saveSnapshot, returns false if missing or corrupt.
+    // The slots are counted against the header, which costs one read pass.
+    bool loadSnapshot(const std::string& file, uint64_t& seq);
+};
+
+// Time deposits, withdrawals and lookups over accounts accounts and print ns per operation
+void benchmarkLedger(size_t accounts, size_t operations);
+
+#endif
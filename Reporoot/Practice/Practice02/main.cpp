@@ -1,36 +1,118 @@
 #include <iostream>
 #include <fstream>
-#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <ctime>
+#include <charconv>
+#include "txlog.h"
+#include "batch.h"
+#include "engine.h"
+#include "replay.h"
+#include "audit.h"
 
 using namespace std;
 
 const string FILE_NAME = "account_balance.txt";
-const double INITIAL_BALANCE = 100.00;
+const string LOG_FILE = "account_balance.log";
+const string CHECKPOINT_FILE = "account_balance.ckpt";
+const string HISTORY_DIR = "account_history";
+const string BATCH_FILE = "account_balance.batches";
+const Money INITIAL_BALANCE(10000);  // $100.00
+const uint64_t DEFAULT_ACCOUNT = 1;  // the single account the old text file held
 
-// Function to read balance from file
-double readBalance() {
+// Function to read the old text balance file, only used before the first checkpoint exists
+Money readBalance() {
     ifstream inFile(FILE_NAME);
-    double balance = INITIAL_BALANCE;
+    Money balance = INITIAL_BALANCE;
+    string text;
 
-    if (inFile) {  // File exists, read balance
-        inFile >> balance;
-    }
-    else {  // File does not exist, create it with initial balance
-        ofstream outFile(FILE_NAME);
-        outFile << fixed << setprecision(2) << INITIAL_BALANCE;
+    if (inFile >> text) {  // File exists, read balance
+        Money::parse(text, balance);
     }
 
     return balance;
 }
 
-// Function to update balance in file
-void updateBalance(double balance) {
-    ofstream outFile(FILE_NAME);
-    if (!outFile) {
-        cout << "Error: Unable to update balance file!" << endl;
-        return;
+// Function to log a transaction and add it to the history
+void updateBalance(TransactionLog& txlog, HistoryWriter& history, RecordType type, uint64_t account,
+    Money amount, const Ledger& ledger) {
+    if (!txlog.append(type, account, amount, ledger)) {
+        cout << "Error: Unable to write transaction log!" << endl;
+    }
+    if (!history.append({ time(nullptr), account, amount, type }) || !history.commit()) {
+        cout << "Error: Unable to write transaction history!" << endl;
+    }
+}
+
+// Function to print an account's history for the last few days, optionally
+// only amounts of at least minAmount and only one type (0 for both)
+int printHistory(uint64_t account, int days, Money minAmount, uint8_t type) {
+    HistoryStore store;
+    if (!store.open(HISTORY_DIR)) {
+        cout << "No transaction history yet.\n";
+        return 0;
+    }
+
+    AuditQuery q;
+    q.account = account;
+    q.fromTime = time(nullptr) - (int64_t)days * 86400;
+    q.minAmount = minAmount;
+    q.type = type;
+    vector<AuditRecord> records;
+    QueryStats stats = store.query(q, records);
+
+    for (const AuditRecord& r : records) {
+        char when[32];
+        time_t t = r.time;
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&t));
+        cout << when << "  " << (r.type == REC_DEPOSIT ? "Deposit   " : "Withdrawal") << "  $" << r.amount << "\n";
+    }
+    cout << records.size() << " transactions (" << stats.skipped << " of " << stats.partitions
+        << " partitions skipped)\n";
+    return 0;
+}
+
+// Function to parse a whole number argument, returns false and says why if it isn't one
+template <class T>
+bool parseArgument(const string& text, T& value) {
+    const char* end = text.data() + text.size();
+    from_chars_result r = from_chars(text.data(), end, value);
+    if (r.ec != errc() || r.ptr != end) {
+        cerr << "Invalid number '" << text << "'\n";
+        return false;
     }
-    outFile << fixed << setprecision(2) << balance;
+    return true;
+}
+
+// Function to read an account ID, returns false on invalid input
+bool readAccount(uint64_t& account) {
+    long long id;
+    cout << "Enter account ID: ";
+    cin >> id;
+
+    if (cin.fail() || id <= 0) {
+        cout << "Invalid account ID. It must be a positive number.\n";
+        cin.clear();
+        cin.ignore(10000, '\n');
+        return false;
+    }
+    account = id;
+    return true;
+}
+
+// Function to read a dollar amount with at most two decimals, returns false on invalid input
+bool readAmount(Money& amount) {
+    string text;
+    cin >> text;
+
+    if (cin.fail() || !Money::parse(text, amount) || amount <= Money()) {
+        cin.clear();
+        cin.ignore(10000, '\n');
+        return false;
+    }
+    return true;
 }
 
 // Function to display menu
@@ -43,9 +125,107 @@ void displayMenu() {
     cout << "Enter your choice: ";
 }
 
-int main() {
-    double balance = readBalance();
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        benchmarkLedger(2000000, 10000000);
+        benchmarkTransactionLog(20000);
+        benchmarkBatchPosting(10000000);
+        benchmarkReplay(10000000);
+        benchmarkTransfers(100000, 1000000, max(4u, thread::hardware_concurrency()));
+        benchmarkPipeline(2000, 16, true);
+        benchmarkPipeline(2000, 16, false);
+        return 0;
+    }
+
+    if (argc > 1 && string(argv[1]) == "--bench-audit") {
+        size_t count = 100000000;
+        if (argc > 2 && !parseArgument(argv[2], count)) return 1;
+        benchmarkAudit(count);
+        return 0;
+    }
+
+    // --audit ACCOUNT [DAYS [MIN [deposits|withdrawals]]]: the account's
+    // transactions of the last DAYS days (30 by default) for MIN dollars or
+    // more, of both types unless one is named
+    if (argc > 2 && string(argv[1]) == "--audit") {
+        uint64_t account;
+        int days = 30;
+        Money minAmount;
+        uint8_t type = 0;
+        if (!parseArgument(argv[2], account) || account == 0 || (argc > 3 && !parseArgument(argv[3], days))) {
+            return 1;
+        }
+        if (argc > 4 && !Money::parse(argv[4], minAmount)) {
+            cerr << "Invalid amount '" << argv[4] << "'\n";
+            return 1;
+        }
+        if (argc > 5) {
+            string name = argv[5];
+            if (name == "deposits") type = REC_DEPOSIT;
+            else if (name == "withdrawals") type = REC_WITHDRAW;
+            else {
+                cerr << "Unknown type '" << name << "' (deposits or withdrawals)\n";
+                return 1;
+            }
+        }
+        return printHistory(account, days, minAmount, type);
+    }
+
+    Ledger ledger;
+    ledger.open(DEFAULT_ACCOUNT, readBalance());  // replaced if a checkpoint exists
+
+    TransactionLog txlog(LOG_FILE, CHECKPOINT_FILE, SYNC_EVERY, 100000);
+    txlog.recover(ledger);
+    txlog.checkpoint(ledger);  // compact whatever was replayed
+
+    // A batch whose checkpoint did not happen before a crash is not applied
+    BatchRegistry batches(BATCH_FILE);
+    if (!batches.load() || !batches.settle(txlog.lastSequence())) {
+        cerr << "Error: Unable to read batch registry '" << BATCH_FILE << "'\n";
+        return 1;
+    }
+
+    if (argc > 2 && string(argv[1]) == "--batch") {
+        BatchStamp stamp;
+        if (!stampFile(argv[2], stamp)) {
+            cerr << "Error: Cannot open file '" << argv[2] << "'\n";
+            return 1;
+        }
+        const BatchRegistry::Entry* earlier = batches.find(stamp);
+        if (earlier && earlier->seq != 0) {
+            cout << "Batch '" << argv[2] << "' was already applied.\n";
+            return 0;
+        }
+
+        // A rerun after a crash stamps its history as the first run did and
+        // writes the same partitions, so the ones that made it are kept as is
+        int64_t when = earlier ? earlier->time : time(nullptr);
+        if (!batches.record(stamp, when, txlog.reserveSequence())) {
+            cerr << "Error: Unable to update batch registry '" << BATCH_FILE << "'\n";
+            return 1;
+        }
+        ReplaySummary summary;
+        HistoryWriter history(HISTORY_DIR, stamp.name(), 86400, 1 << 20);
+        if (!replayFile(argv[2], ledger, summary, &history, when)) {
+            cerr << "Error: Cannot open file '" << argv[2] << "'\n";
+            return 1;
+        }
+        if (!history.flush()) {
+            cerr << "Error: Unable to write transaction history!\n";
+            return 1;
+        }
+        if (!txlog.checkpoint(ledger)) {
+            cerr << "Error: Unable to save checkpoint!\n";
+            return 1;
+        }
+        printSummary(summary);
+        return 0;
+    }
+
+    HistoryWriter history(HISTORY_DIR);
+
     int choice;
+    uint64_t account;
 
     do {
         displayMenu();
@@ -58,46 +238,55 @@ int main() {
             continue;
         }
 
+        if (choice >= 1 && choice <= 3 && !readAccount(account)) {
+            continue;
+        }
+
         switch (choice) {
-        case 1:
-            cout << "Your balance: $" << fixed << setprecision(2) << balance << endl;
+        case 1: {
+            const Money* balance = ledger.find(account);
+            if (!balance) {
+                cout << "Account not found.\n";
+            }
+            else {
+                cout << "Your balance: $" << *balance << endl;
+            }
             break;
+        }
 
         case 2: {
-            double deposit;
+            Money deposit;
             cout << "Enter deposit amount: $";
-            cin >> deposit;
 
-            if (cin.fail() || deposit <= 0) {
+            if (!readAmount(deposit)) {
                 cout << "Invalid amount. Deposit must be positive.\n";
-                cin.clear();
-                cin.ignore(10000, '\n');
+            }
+            else if (!ledger.deposit(account, deposit)) {
+                cout << "Deposit rejected. Balance would be too large.\n";
             }
             else {
-                balance += deposit;
-                updateBalance(balance);
-                cout << "Deposit successful. New balance: $" << balance << endl;
+                updateBalance(txlog, history, REC_DEPOSIT, account, deposit, ledger);
+                cout << "Deposit successful. New balance: $" << *ledger.find(account) << endl;
             }
             break;
         }
 
         case 3: {
-            double withdraw;
+            Money withdraw;
             cout << "Enter withdrawal amount: $";
-            cin >> withdraw;
 
-            if (cin.fail() || withdraw <= 0) {
+            if (!readAmount(withdraw)) {
                 cout << "Invalid amount. Withdrawal must be positive.\n";
-                cin.clear();
-                cin.ignore(10000, '\n');
             }
-            else if (withdraw > balance) {
-                cout << "Insufficient funds. Your balance is: $" << balance << endl;
+            else if (!ledger.find(account)) {
+                cout << "Account not found.\n";
+            }
+            else if (!ledger.withdraw(account, withdraw)) {
+                cout << "Insufficient funds. Your balance is: $" << *ledger.find(account) << endl;
             }
             else {
-                balance -= withdraw;
-                updateBalance(balance);
-                cout << "Withdrawal successful! New balance: $" << balance << endl;
+                updateBalance(txlog, history, REC_WITHDRAW, account, withdraw, ledger);
+                cout << "Withdrawal successful! New balance: $" << *ledger.find(account) << endl;
             }
             break;
         }
@@ -0,0 +1,115 @@
+#ifndef MONEY_H
+#define MONEY_H
+
+#include <cstdint>
+#include <cmath>
+#include <ostream>
+#include <string>
+
+// An amount of money as a whole number of cents, so sums never drift.
+// Arithmetic that could overflow goes through the checked helpers.
+class Money {
+private:
+    int64_t cents;
+
+public:
+    constexpr Money() : cents(0) {}
+    constexpr explicit Money(int64_t cents) : cents(cents) {}
+
+    static Money fromDouble(double amount) {
+        return Money(std::llround(amount * 100.0));
+    }
+
+    // Parse "12", "12.3" or "12.34" exactly, returns false on anything else
+    static bool parse(const char* text, size_t len, Money& out) {
+        size_t i = 0;
+        bool negative = false;
+        if (i < len && (text[i] == '-' || text[i] == '+')) negative = (text[i++] == '-');
+        if (i == len) return false;
+
+        int64_t whole = 0;
+        size_t digits = 0;
+        for (; i < len && text[i] >= '0' && text[i] <= '9'; i++, digits++) {
+            if (__builtin_mul_overflow(whole, 10, &whole)
+                || __builtin_add_overflow(whole, text[i] - '0', &whole)) return false;
+        }
+
+        int64_t frac = 0;
+        if (i < len && text[i] == '.') {
+            i++;
+            size_t fracDigits = 0;
+            for (; i < len && text[i] >= '0' && text[i] <= '9'; i++, fracDigits++) {
+                if (fracDigits == 2) return false;
+                frac = frac * 10 + (text[i] - '0');
+            }
+            if (fracDigits == 1) frac *= 10;
+            digits += fracDigits;
+        }
+        if (i != len || digits == 0) return false;
+
+        int64_t total;
+        if (__builtin_mul_overflow(whole, 100, &total) || __builtin_add_overflow(total, frac, &total))
+            return false;
+        out = Money(negative ? -total : total);
+        return true;
+    }
+
+    static bool parse(const std::string& text, Money& out) {
+        return parse(text.data(), text.size(), out);
+    }
+
+    constexpr int64_t toCents() const { return cents; }
+    double toDouble() const { return cents / 100.0; }
+
+    // Returns false and leaves out alone if the result does not fit
+    friend bool checkedAdd(Money a, Money b, Money& out) {
+        int64_t sum;
+        if (__builtin_add_overflow(a.cents, b.cents, &sum)) return false;
+        out = Money(sum);
+        return true;
+    }
+
+    friend bool checkedSub(Money a, Money b, Money& out) {
+        int64_t diff;
+        if (__builtin_sub_overflow(a.cents, b.cents, &diff)) return false;
+        out = Money(diff);
+        return true;
+    }
+
+    constexpr bool operator==(Money other) const { return cents == other.cents; }
+    constexpr bool operator!=(Money other) const { return cents != other.cents; }
+    constexpr bool operator<(Money other) const { return cents < other.cents; }
+    constexpr bool operator>(Money other) const { return cents > other.cents; }
+    constexpr bool operator<=(Money other) const { return cents <= other.cents; }
+    constexpr bool operator>=(Money other) const { return cents >= other.cents; }
+
+    // Formats as "1234.56" into buf (at least 24 bytes), returns the length
+    int format(char* buf) const {
+        uint64_t v = cents < 0 ? 0 - (uint64_t)cents : (uint64_t)cents;
+        char tmp[24];
+        int n = 0;
+        tmp[n++] = '0' + v % 10; v /= 10;
+        tmp[n++] = '0' + v % 10; v /= 10;
+        tmp[n++] = '.';
+        do {
+            tmp[n++] = '0' + v % 10;
+            v /= 10;
+        } while (v > 0);
+        if (cents < 0) tmp[n++] = '-';
+
+        for (int i = 0; i < n; i++) buf[i] = tmp[n - 1 - i];
+        return n;
+    }
+
+    std::string toString() const {
+        char buf[24];
+        return std::string(buf, format(buf));
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, Money m) {
+        char buf[24];
+        return os.write(buf, m.format(buf));
+    }
+};
+
+#endif
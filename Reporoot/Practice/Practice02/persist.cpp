@@ -0,0 +1,358 @@
+#include "persist.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+// Minimal io_uring setup through the raw syscalls, so there is no liburing dependency
+struct DurablePipeline::Uring {
+    int fd = -1;
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    size_t sqRingSize = 0, cqRingSize = 0, sqesSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    unsigned *sqTail = nullptr, *sqMask = nullptr, *sqArray = nullptr;
+    unsigned *cqHead = nullptr, *cqTail = nullptr, *cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    bool setup(unsigned entries) {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (fd < 0) return false;
+
+        sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) return false;
+        cqRing = single ? sqRing
+            : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) return false;
+        sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) return false;
+
+        char* sq = static_cast<char*>(sqRing);
+        char* cq = static_cast<char*>(cqRing);
+        sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    ~Uring() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+        if (fd >= 0) close(fd);
+    }
+
+    io_uring_sqe* nextSqe(unsigned& tail) {
+        unsigned index = tail & *sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqArray[index] = index;
+        tail++;
+        return sqe;
+    }
+
+    // Write buf at offset and fdatasync it, linked so the sync only runs after the write
+    bool writeAndSync(int file, const unsigned char* buf, size_t len, uint64_t offset, int& written) {
+        unsigned tail = *sqTail;
+        io_uring_sqe* w = nextSqe(tail);
+        w->opcode = IORING_OP_WRITE;
+        w->fd = file;
+        w->addr = reinterpret_cast<uint64_t>(buf);
+        w->len = (uint32_t)len;
+        w->off = offset;
+        w->flags = IOSQE_IO_LINK;
+        w->user_data = 1;
+
+        io_uring_sqe* s = nextSqe(tail);
+        s->opcode = IORING_OP_FSYNC;
+        s->fd = file;
+        s->fsync_flags = IORING_FSYNC_DATASYNC;
+        s->user_data = 2;
+        __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+        int submitted = 0, reaped = 0;
+        bool synced = false;
+        written = -1;
+        while (reaped < 2) {
+            int toSubmit = submitted == 0 ? 2 : 0;
+            if (syscall(__NR_io_uring_enter, fd, toSubmit, 2 - reaped, IORING_ENTER_GETEVENTS, nullptr, 0) < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            submitted = 2;
+
+            unsigned h = *cqHead;
+            while (h != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                io_uring_cqe* cqe = &cqes[h & *cqMask];
+                if (cqe->user_data == 1) written = cqe->res;
+                else synced = cqe->res == 0;
+                h++;
+                reaped++;
+            }
+            __atomic_store_n(cqHead, h, __ATOMIC_RELEASE);
+        }
+        return synced && written == (int)len;
+    }
+};
+
+namespace {
+
+bool pwriteAll(int fd, const unsigned char* buf, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, buf, len, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        buf += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+}
+
+LatencyHistogram::LatencyHistogram() {
+    clear();
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds latency) {
+    uint64_t ns = std::max<int64_t>(latency.count(), 1);
+    int bucket = std::min(63 - __builtin_clzll(ns), BUCKETS - 1);
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::clear() {
+    for (auto& b : buckets) b.store(0);
+    total.store(0);
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    uint64_t n = total.load();
+    if (n == 0) return 0;
+    uint64_t target = std::max<uint64_t>(1, (uint64_t)(fraction * n));
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += buckets[i].load();
+        if (seen >= target) return 2ULL << i;
+    }
+    return 2ULL << (BUCKETS - 1);
+}
+
+void LatencyHistogram::print(const char* name) const {
+    std::cout << "  " << std::setw(6) << std::left << name << std::right << std::fixed << std::setprecision(1)
+        << " p50 <" << percentile(0.50) / 1000.0 << "us"
+        << " p99 <" << percentile(0.99) / 1000.0 << "us"
+        << " p99.9 <" << percentile(0.999) / 1000.0 << "us\n";
+}
+
+DurablePipeline::DurablePipeline(const std::string& file, uint64_t startOffset,
+    size_t ringCapacity, size_t maxBatch, unsigned fallbackThreads, bool tryIoUring)
+    : fd(-1), ring(ringCapacity), maxBatch(maxBatch), head(0), tail(0), lastTicket(0),
+    durableTicket(0), nextBatch(1), durableBatch(0), nextOffset(startOffset),
+    failed(false), stopping(false), collectorFinished(false) {
+    // No O_APPEND: every batch is written at the offset it was assigned
+    fd = open(file.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Unable to open '" << file << "' for writing\n";
+        failed = true;
+        return;
+    }
+
+    if (tryIoUring) {
+        uring.reset(new Uring());
+        if (!uring->setup(8)) uring.reset();
+    }
+    if (!uring) {
+        for (unsigned i = 0; i < std::max(1u, fallbackThreads); i++)
+            workers.emplace_back(&DurablePipeline::workerLoop, this);
+    }
+    collector = std::thread(&DurablePipeline::collect, this);
+}
+
+DurablePipeline::~DurablePipeline() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    notEmpty.notify_all();
+    if (collector.joinable()) collector.join();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        collectorFinished = true;
+    }
+    pendingReady.notify_all();
+    for (auto& w : workers) w.join();
+    if (fd >= 0) close(fd);
+}
+
+uint64_t DurablePipeline::submit(const void* data, size_t len) {
+    if (len > MAX_RECORD) return 0;
+    std::unique_lock<std::mutex> guard(lock);
+    if (fd < 0) return 0;
+    notFull.wait(guard, [&] { return tail - head < ring.size(); });
+
+    Entry& e = ring[tail % ring.size()];
+    e.queued = Clock::now();
+    e.len = (uint32_t)len;
+    memcpy(e.data, data, len);
+    tail++;
+    uint64_t ticket = ++lastTicket;
+    guard.unlock();
+    notEmpty.notify_one();
+    return ticket;
+}
+
+bool DurablePipeline::waitDurable(uint64_t ticket) {
+    std::unique_lock<std::mutex> guard(lock);
+    durable.wait(guard, [&] { return durableTicket >= ticket || failed; });
+    return !failed;
+}
+
+bool DurablePipeline::reset(uint64_t offset) {
+    std::unique_lock<std::mutex> guard(lock);
+    uint64_t target = lastTicket;
+    durable.wait(guard, [&] { return durableTicket >= target || failed; });
+    nextOffset = offset;
+    return !failed;
+}
+
+void DurablePipeline::collect() {
+    for (;;) {
+        Batch batch;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            notEmpty.wait(guard, [&] { return tail > head || stopping; });
+            if (tail == head) break;
+
+            // Everything queued while the last batch was on its way out goes in this one
+            size_t n = std::min<uint64_t>(tail - head, maxBatch);
+            batch.formed = Clock::now();
+            batch.records = n;
+            batch.buffer.reserve(n * MAX_RECORD);
+            for (size_t i = 0; i < n; i++) {
+                const Entry& e = ring[(head + i) % ring.size()];
+                queueLatency.record(batch.formed - e.queued);
+                batch.buffer.insert(batch.buffer.end(), e.data, e.data + e.len);
+            }
+            head += n;
+            batch.id = nextBatch++;
+            batch.lastTicket = head;
+            batch.offset = nextOffset;
+            nextOffset += batch.buffer.size();
+        }
+        notFull.notify_all();
+
+        if (uring) {
+            writeWithUring(batch);
+        }
+        else {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                pending.push_back(std::move(batch));
+            }
+            pendingReady.notify_one();
+        }
+    }
+}
+
+void DurablePipeline::writeWithUring(Batch& batch) {
+    int written = 0;
+    bool success = uring->writeAndSync(fd, batch.buffer.data(), batch.buffer.size(), batch.offset, written);
+    if (!success) {
+        // Short or failed write: finish the batch the plain way
+        size_t done = written > 0 ? written : 0;
+        success = pwriteAll(fd, batch.buffer.data() + done, batch.buffer.size() - done, batch.offset + done)
+            && fdatasync(fd) == 0;
+    }
+    complete(batch, success);
+}
+
+void DurablePipeline::workerLoop() {
+    for (;;) {
+        Batch batch;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            pendingReady.wait(guard, [&] { return !pending.empty() || collectorFinished; });
+            if (pending.empty()) break;
+            batch = std::move(pending.front());
+            pending.pop_front();
+        }
+        bool success = pwriteAll(fd, batch.buffer.data(), batch.buffer.size(), batch.offset)
+            && fdatasync(fd) == 0;
+        complete(batch, success);
+    }
+}
+
+void DurablePipeline::complete(const Batch& batch, bool success) {
+    writeLatency.record(Clock::now() - batch.formed);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!success) failed = true;
+
+        // Batches can finish out of order on the pool; only acknowledge a contiguous prefix
+        finished[batch.id] = batch.lastTicket;
+        auto it = finished.begin();
+        while (it != finished.end() && it->first == durableBatch + 1) {
+            durableBatch = it->first;
+            durableTicket = it->second;
+            it = finished.erase(it);
+        }
+    }
+    durable.notify_all();
+}
+
+void benchmarkPipeline(size_t recordsPerThread, unsigned maxThreads, bool tryIoUring) {
+    const char* file = "bench_pipeline.log";
+    unsigned char record[40];
+    memset(record, 0xAB, sizeof(record));
+
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        unlink(file);
+        DurablePipeline pipeline(file, 0, 4096, 512, 2, tryIoUring);
+        LatencyHistogram total;
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> producers;
+        for (unsigned t = 0; t < threads; t++) {
+            producers.emplace_back([&]() {
+                for (size_t i = 0; i < recordsPerThread; i++) {
+                    auto begin = std::chrono::steady_clock::now();
+                    pipeline.waitDurable(pipeline.submit(record, sizeof(record)));
+                    total.record(std::chrono::steady_clock::now() - begin);
+                }
+            });
+        }
+        for (auto& p : producers) p.join();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << (pipeline.usingIoUring() ? "io_uring" : "threads") << " "
+            << std::setw(3) << threads << " producers  " << std::fixed << std::setprecision(0)
+            << threads * recordsPerThread / seconds << " durable tx/s\n";
+        pipeline.queueLatency.print("queue");
+        pipeline.writeLatency.print("write");
+        total.print("total");
+    }
+    unlink(file);
+}
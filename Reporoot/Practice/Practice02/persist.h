@@ -0,0 +1,120 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Log2-bucketed latency counts, safe to record from many threads
+class LatencyHistogram {
+private:
+    static const int BUCKETS = 48;
+    std::atomic<uint64_t> buckets[BUCKETS];
+    std::atomic<uint64_t> total;
+
+public:
+    LatencyHistogram();
+    void record(std::chrono::nanoseconds latency);
+    void clear();
+
+    // Upper bound of the bucket holding the given fraction (0..1) of samples, in ns
+    uint64_t percentile(double fraction) const;
+    void print(const char* name) const;
+};
+
+// Separate persistence stage for small records. Callers queue records into a
+// bounded ring; one collector thread drains everything queued so far into a
+// batch and writes it with a linked write + fdatasync on io_uring. If io_uring
+// is not available batches go to a small pool of pwrite/fdatasync threads.
+// A ticket is durable once its batch and every batch before it are on disk.
+class DurablePipeline {
+public:
+    static const size_t MAX_RECORD = 64;
+
+    DurablePipeline(const std::string& file, uint64_t startOffset,
+        size_t ringCapacity = 4096, size_t maxBatch = 512, unsigned fallbackThreads = 2,
+        bool tryIoUring = true);
+    ~DurablePipeline();
+    DurablePipeline(const DurablePipeline&) = delete;
+    DurablePipeline& operator=(const DurablePipeline&) = delete;
+
+    bool ok() const { return fd >= 0; }
+    bool usingIoUring() const { return uring != nullptr; }
+
+    // Queue one record, blocks while the ring is full. Returns 0, queueing
+    // nothing, if the record is over MAX_RECORD bytes or the file is not open.
+    uint64_t submit(const void* data, size_t len);
+
+    // Block until ticket is on disk, returns false if a write failed
+    bool waitDurable(uint64_t ticket);
+
+    // Wait for everything queued so far, then continue writing at offset
+    bool reset(uint64_t offset);
+
+    LatencyHistogram queueLatency;  // submit() until the collector picks the record up
+    LatencyHistogram writeLatency;  // collector pickup until the batch is durable
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry {
+        Clock::time_point queued;
+        uint32_t len;
+        unsigned char data[MAX_RECORD];
+    };
+
+    struct Batch {
+        uint64_t id;
+        uint64_t lastTicket;
+        uint64_t offset;
+        size_t records;
+        Clock::time_point formed;
+        std::vector<unsigned char> buffer;
+    };
+
+    struct Uring;
+
+    int fd;
+    std::unique_ptr<Uring> uring;
+
+    std::mutex lock;
+    std::condition_variable notEmpty, notFull, durable;
+    std::vector<Entry> ring;
+    size_t maxBatch;
+    uint64_t head, tail;        // ring positions, tail - head entries are queued
+    uint64_t lastTicket;        // tickets are 1-based, ticket n lives at ring position n - 1
+    uint64_t durableTicket;
+    uint64_t nextBatch, durableBatch;
+    uint64_t nextOffset;
+    std::map<uint64_t, uint64_t> finished;  // batch id -> last ticket, waiting for earlier batches
+    bool failed;
+    bool stopping;
+    bool collectorFinished;  // no more batches will reach the pool
+
+    std::thread collector;
+
+    // Fallback pool
+    std::vector<std::thread> workers;
+    std::deque<Batch> pending;
+    std::condition_variable pendingReady;
+
+    void collect();
+    void writeWithUring(Batch& batch);
+    void workerLoop();
+    void complete(const Batch& batch, bool success);
+};
+
+// Post records from 1..maxThreads producer threads that each wait for
+// durability, print throughput and queue/write latency percentiles
+void benchmarkPipeline(size_t recordsPerThread, unsigned maxThreads, bool tryIoUring);
+
+#endif
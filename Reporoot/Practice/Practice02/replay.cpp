@@ -0,0 +1,273 @@
+#include "replay.h"
+#include "batch.h"
+#include "../common/crc32.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+const size_t BATCH_SIZE = 1 << 16;
+const size_t MAX_REPORTED = 10;  // invalid lines echoed to stderr before going quiet
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && isSpace(*p)) p++;
+    return p;
+}
+
+// Parse one line in place. Returns 1 for a posting, 0 for a blank/comment line, -1 if invalid.
+int parseLine(const char* p, const char* end, RecordType& type, uint64_t& account, Money& amount) {
+    p = skipSpaces(p, end);
+    if (p == end || *p == '#') return 0;
+
+    if (*p == 'D') type = REC_DEPOSIT;
+    else if (*p == 'W') type = REC_WITHDRAW;
+    else return -1;
+    p++;
+    if (p == end || !isSpace(*p)) return -1;
+    p = skipSpaces(p, end);
+
+    account = 0;
+    const char* digits = p;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        if (__builtin_mul_overflow(account, 10, &account)
+            || __builtin_add_overflow(account, (uint64_t)(*p - '0'), &account)) return -1;
+    }
+    if (p == digits || account == 0 || account == Ledger::EMPTY_ID) return -1;
+    if (p == end || !isSpace(*p)) return -1;
+    p = skipSpaces(p, end);
+
+    const char* token = p;
+    while (p < end && !isSpace(*p)) p++;
+    if (!Money::parse(token, p - token, amount) || amount <= Money()) return -1;
+
+    return skipSpaces(p, end) == end ? 1 : -1;
+}
+
+void applyBatch(Ledger& ledger, PostingBatch& batch, std::vector<uint8_t>& accepted, ReplaySummary& summary,
+    HistoryWriter* history, int64_t when) {
+    postBatch(ledger, batch, accepted.data());
+
+    for (size_t i = 0; i < batch.size(); i++) {
+        int64_t cents = batch.amounts[i];
+        if (history && accepted[i]) {
+            history->append({ when, batch.accounts[i], Money(cents > 0 ? cents : -cents),
+                cents > 0 ? REC_DEPOSIT : REC_WITHDRAW });
+        }
+        if (cents > 0) {
+            if (accepted[i]) {
+                summary.deposits++;
+                checkedAdd(summary.deposited, Money(cents), summary.deposited);
+            }
+            else {
+                summary.rejectedDeposits++;
+            }
+        }
+        else {
+            if (accepted[i]) {
+                summary.withdrawals++;
+                checkedAdd(summary.withdrawn, Money(-cents), summary.withdrawn);
+            }
+            else {
+                summary.rejectedWithdrawals++;
+            }
+        }
+    }
+    batch.clear();
+}
+
+}
+
+bool replayFile(const std::string& file, Ledger& ledger, ReplaySummary& summary, HistoryWriter* history,
+    int64_t when) {
+    auto start = std::chrono::steady_clock::now();
+    if (when == -1) when = time(nullptr);
+
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    const char* data = nullptr;
+    size_t size = st.st_size;
+    if (size > 0) {
+        void* m = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        madvise(m, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(m);
+    }
+    close(fd);
+
+    PostingBatch batch;
+    batch.accounts.reserve(BATCH_SIZE);
+    batch.amounts.reserve(BATCH_SIZE);
+    std::vector<uint8_t> accepted(BATCH_SIZE);
+
+    const char* p = data;
+    const char* end = data + size;
+    while (p < end) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+        summary.lines++;
+
+        RecordType type;
+        uint64_t account;
+        Money amount;
+        int parsed = parseLine(p, eol, type, account, amount);
+        if (parsed > 0 && !batch.add(account, type, amount)) parsed = -1;
+        if (parsed < 0) {
+            if (summary.invalid < MAX_REPORTED)
+                std::cerr << file << ":" << summary.lines << ": invalid transaction\n";
+            summary.invalid++;
+        }
+
+        if (batch.size() == BATCH_SIZE) applyBatch(ledger, batch, accepted, summary, history, when);
+        p = eol + 1;
+    }
+    applyBatch(ledger, batch, accepted, summary, history, when);
+
+    if (data) munmap(const_cast<char*>(data), size);
+    summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+std::string BatchStamp::name() const {
+    char text[32];
+    snprintf(text, sizeof(text), "b%08x%llx", crc, (unsigned long long)size);
+    return text;
+}
+
+bool stampFile(const std::string& file, BatchStamp& stamp) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    stamp.size = ok ? st.st_size : 0;
+    stamp.crc = 0;
+    if (ok && stamp.size > 0) {
+        void* m = mmap(nullptr, stamp.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ok = m != MAP_FAILED;
+        if (ok) {
+            madvise(m, stamp.size, MADV_SEQUENTIAL);
+            stamp.crc = crc32(static_cast<const unsigned char*>(m), stamp.size);
+            munmap(m, stamp.size);
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+bool BatchRegistry::load() {
+    entries.clear();
+    std::ifstream in(file);
+    if (!in) return access(file.c_str(), F_OK) != 0;
+    Entry e;
+    while (in >> e.stamp.size >> e.stamp.crc >> e.time >> e.seq) entries.push_back(e);
+    return in.eof();
+}
+
+bool BatchRegistry::settle(uint64_t lastSeq) {
+    bool changed = false;
+    for (Entry& e : entries) {
+        if (e.seq > lastSeq) {
+            e.seq = 0;
+            changed = true;
+        }
+    }
+    return !changed || save();
+}
+
+const BatchRegistry::Entry* BatchRegistry::find(const BatchStamp& stamp) const {
+    for (const Entry& e : entries) {
+        if (e.stamp.size == stamp.size && e.stamp.crc == stamp.crc) return &e;
+    }
+    return nullptr;
+}
+
+bool BatchRegistry::record(const BatchStamp& stamp, int64_t time, uint64_t seq) {
+    for (Entry& e : entries) {
+        if (e.stamp.size == stamp.size && e.stamp.crc == stamp.crc) {
+            e.time = time;
+            e.seq = seq;
+            return save();
+        }
+    }
+    entries.push_back({ stamp, time, seq });
+    return save();
+}
+
+bool BatchRegistry::save() const {
+    // Written to a temp file and renamed over the old one, like the checkpoint
+    std::string tmp = file + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        for (const Entry& e : entries) {
+            out << e.stamp.size << ' ' << e.stamp.crc << ' ' << e.time << ' ' << e.seq << '\n';
+        }
+        if (!out.flush()) return false;
+    }
+    int fd = open(tmp.c_str(), O_RDONLY);
+    bool ok = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0) close(fd);
+    if (!ok || rename(tmp.c_str(), file.c_str()) != 0) return false;
+
+    std::string dir = file.find('/') == std::string::npos ? "." : file.substr(0, file.rfind('/'));
+    fd = open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+    return true;
+}
+
+void printSummary(const ReplaySummary& summary) {
+    std::cout << "\n--- Replay Summary ---\n";
+    std::cout << "Lines read: " << summary.lines << "\n";
+    std::cout << "Invalid lines: " << summary.invalid << "\n";
+    std::cout << "Deposits: " << summary.deposits << " ($" << summary.deposited << "), "
+        << summary.rejectedDeposits << " rejected\n";
+    std::cout << "Withdrawals: " << summary.withdrawals << " ($" << summary.withdrawn << "), "
+        << summary.rejectedWithdrawals << " rejected\n";
+    std::cout << std::fixed << std::setprecision(3) << "Time: " << summary.seconds << " s";
+    if (summary.seconds > 0)
+        std::cout << " (" << std::setprecision(1) << summary.lines / summary.seconds / 1e6 << "M lines/s)";
+    std::cout << "\n";
+}
+
+void benchmarkReplay(size_t count) {
+    const char* file = "bench_replay.txt";
+    {
+        std::ofstream out(file);
+        std::mt19937_64 rng(11);
+        for (size_t i = 0; i < count; i++) {
+            out << ((rng() % 2) ? 'D' : 'W') << ' ' << 1 + rng() % 100000 << ' '
+                << Money(1 + rng() % 100000) << '\n';
+        }
+    }
+
+    Ledger ledger;
+    ReplaySummary summary;
+    replayFile(file, ledger, summary);
+    std::cout << "replay " << count << " lines: " << std::fixed << std::setprecision(3)
+        << summary.seconds << " s, " << std::setprecision(1)
+        << summary.lines / summary.seconds / 1e6 << "M lines/s\n";
+    unlink(file);
+}
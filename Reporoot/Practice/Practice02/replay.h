@@ -0,0 +1,83 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ledger.h"
+#include "audit.h"
+
+struct ReplaySummary {
+    size_t lines = 0;
+    size_t invalid = 0;             // lines that failed the menu's input rules
+    size_t deposits = 0;
+    size_t withdrawals = 0;
+    size_t rejectedDeposits = 0;    // balance would overflow
+    size_t rejectedWithdrawals = 0; // insufficient funds or unknown account
+    Money deposited;
+    Money withdrawn;
+    double seconds = 0.0;
+};
+
+// Apply a transaction file to the ledger without going through the menu.
+// Each line is "D <account> <amount>" or "W <account> <amount>"; blank lines
+// and lines starting with '#' are skipped. The file is memory-mapped and
+// tokenized in place, and postings are applied in fixed-size batches.
+// Applied postings are added to history if one is given, stamped with time
+// when (now if it is -1).
+bool replayFile(const std::string& file, Ledger& ledger, ReplaySummary& summary,
+    HistoryWriter* history = nullptr, int64_t when = -1);
+
+// Identifies a transaction file by its contents
+struct BatchStamp {
+    uint64_t size = 0;
+    uint32_t crc = 0;
+
+    // Name for the history partitions written by this batch
+    std::string name() const;
+};
+
+bool stampFile(const std::string& file, BatchStamp& stamp);
+
+// Text file of the transaction files replayed so far, so the same file is
+// not applied twice. Each entry keeps the time its history was stamped with
+// and the log sequence number reserved for it; the batch is done once a
+// checkpoint covers that number. Entries with a sequence number of 0 were
+// started but never checkpointed and may be run again.
+class BatchRegistry {
+public:
+    struct Entry {
+        BatchStamp stamp;
+        int64_t time;
+        uint64_t seq;
+    };
+
+private:
+    std::string file;
+    std::vector<Entry> entries;
+
+public:
+    explicit BatchRegistry(const std::string& file) : file(file) {}
+
+    // False if the file exists but can't be read
+    bool load();
+
+    // Mark every batch whose sequence number lies past what the checkpoint
+    // and log recovered as unfinished, and save if anything changed
+    bool settle(uint64_t lastSeq);
+
+    const Entry* find(const BatchStamp& stamp) const;
+
+    // Add or update the entry for stamp and save the registry
+    bool record(const BatchStamp& stamp, int64_t time, uint64_t seq);
+
+    bool save() const;
+};
+
+void printSummary(const ReplaySummary& summary);
+
+// Write a synthetic transaction file of count lines and time replaying it
+void benchmarkReplay(size_t count);
+
+#endif
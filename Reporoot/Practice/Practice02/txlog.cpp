@@ -0,0 +1,245 @@
+#include "txlog.h"
+#include "../common/crc32.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+const uint32_t LOG_MAGIC = 0x324C5854;  // "TXL2"
+const int RECORD_SIZE = 40;             // magic, type, seq, cents, account, crc
+const int CRC_OFFSET = 32;
+
+bool writeAll(int fd, const unsigned char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+// fsync the directory holding path so a rename into it is durable
+void syncParentDir(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string dir = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+    int dfd = open(dir.c_str(), O_RDONLY);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+}
+
+}
+
+TransactionLog::TransactionLog(const std::string& logFile, const std::string& checkpointFile,
+    SyncMode mode, int checkpointEvery)
+    : logFile(logFile), checkpointFile(checkpointFile), mode(mode), checkpointEvery(checkpointEvery),
+    fd(-1), nextSeq(1), sinceCheckpoint(0), writtenSeq(0), durableSeq(0), syncing(false) {}
+
+TransactionLog::~TransactionLog() {
+    if (fd >= 0) {
+        sync();
+        close(fd);
+    }
+}
+
+bool TransactionLog::recover(Ledger& ledger) {
+    uint64_t seq = 0;
+    bool found = ledger.loadSnapshot(checkpointFile, seq);
+    nextSeq = seq + 1;
+
+    fd = open(logFile.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Unable to open transaction log '" << logFile << "'\n";
+        return found;
+    }
+
+    // Replay whole records until the end or the first torn/corrupt one
+    unsigned char buf[RECORD_SIZE * 256];
+    off_t good = 0;
+    bool done = false;
+    while (!done) {
+        ssize_t n = pread(fd, buf, sizeof(buf), good);
+        if (n <= 0) break;
+
+        for (ssize_t off = 0; off + RECORD_SIZE <= n; off += RECORD_SIZE) {
+            const unsigned char* rec = buf + off;
+            uint32_t magic, crc;
+            uint64_t recSeq, account;
+            int64_t cents;
+            memcpy(&magic, rec, 4);
+            memcpy(&recSeq, rec + 8, 8);
+            memcpy(&cents, rec + 16, 8);
+            memcpy(&account, rec + 24, 8);
+            memcpy(&crc, rec + CRC_OFFSET, 4);
+
+            if (magic != LOG_MAGIC || crc != crc32(rec, CRC_OFFSET)) {
+                done = true;
+                break;
+            }
+            if (recSeq >= nextSeq) {
+                if (rec[4] == REC_DEPOSIT) ledger.deposit(account, Money(cents));
+                else ledger.withdraw(account, Money(cents));
+                nextSeq = recSeq + 1;
+            }
+            good += RECORD_SIZE;
+        }
+        if (n < (ssize_t)sizeof(buf)) break;
+    }
+
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size > good) {
+        std::cerr << "Warning: Dropped " << (size - good) << " bytes of incomplete log records\n";
+        if (ftruncate(fd, good) == 0) fsync(fd);
+    }
+
+    if (mode == SYNC_ASYNC) pipeline.reset(new DurablePipeline(logFile, good));
+    writtenSeq = durableSeq = nextSeq - 1;
+    return found;
+}
+
+bool TransactionLog::append(RecordType type, uint64_t account, Money amount, const Ledger& ledger) {
+    unsigned char rec[RECORD_SIZE] = {};
+    int64_t cents = amount.toCents();
+    memcpy(rec, &LOG_MAGIC, 4);
+    rec[4] = type;
+    memcpy(rec + 16, &cents, 8);
+    memcpy(rec + 24, &account, 8);
+
+    // Sequence numbers are handed out and written under the lock, so the
+    // file holds them in order
+    std::unique_lock<std::mutex> guard(lock);
+    if (fd < 0) return false;
+    uint64_t seq = nextSeq++;
+    memcpy(rec + 8, &seq, 8);
+    uint32_t crc = crc32(rec, CRC_OFFSET);
+    memcpy(rec + CRC_OFFSET, &crc, 4);
+
+    if (pipeline) {
+        uint64_t ticket = pipeline->submit(rec, RECORD_SIZE);
+        guard.unlock();
+        if (ticket == 0 || !pipeline->waitDurable(ticket)) return false;
+        guard.lock();
+    }
+    else {
+        if (!writeAll(fd, rec, RECORD_SIZE)) return false;
+        writtenSeq = seq;
+        if (mode == SYNC_EVERY) {
+            if (fdatasync(fd) != 0) return false;
+            durableSeq = seq;
+        }
+        else if (mode == SYNC_GROUP && !syncThrough(guard, seq)) {
+            return false;
+        }
+    }
+
+    if (checkpointEvery > 0 && ++sinceCheckpoint >= checkpointEvery)
+        return writeCheckpoint(ledger);
+    return true;
+}
+
+// Group commit: the first thread to need a sync runs one for everything
+// written so far, and records written while it runs wait for the next.
+// Returns once a sync that started after record seq was written has
+// finished.
+bool TransactionLog::syncThrough(std::unique_lock<std::mutex>& guard, uint64_t seq) {
+    while (durableSeq < seq) {
+        if (syncing) {
+            synced.wait(guard);
+            continue;
+        }
+        syncing = true;
+        uint64_t target = writtenSeq;
+        guard.unlock();
+        bool ok = fdatasync(fd) == 0;
+        guard.lock();
+        syncing = false;
+        if (ok) durableSeq = std::max(durableSeq, target);
+        synced.notify_all();
+        if (!ok) return false;
+    }
+    return true;
+}
+
+void TransactionLog::sync() {
+    std::unique_lock<std::mutex> guard(lock);
+    if (fd >= 0 && (mode == SYNC_EVERY || mode == SYNC_GROUP)) {
+        syncThrough(guard, writtenSeq);
+    }
+}
+
+bool TransactionLog::checkpoint(const Ledger& ledger) {
+    std::unique_lock<std::mutex> guard(lock);
+    return writeCheckpoint(ledger);
+}
+
+uint64_t TransactionLog::lastSequence() {
+    std::unique_lock<std::mutex> guard(lock);
+    return nextSeq - 1;
+}
+
+uint64_t TransactionLog::reserveSequence() {
+    std::unique_lock<std::mutex> guard(lock);
+    return nextSeq++;
+}
+
+bool TransactionLog::writeCheckpoint(const Ledger& ledger) {
+    // The snapshot goes to a temp file and is renamed over the old one, so a crash leaves one intact
+    if (!ledger.saveSnapshot(checkpointFile, nextSeq - 1)) return false;
+    syncParentDir(checkpointFile);
+
+    // Everything in the log is now covered by the checkpoint
+    if (pipeline && !pipeline->reset(0)) return false;
+    if (fd >= 0 && ftruncate(fd, 0) == 0) fsync(fd);
+    durableSeq = std::max(durableSeq, nextSeq - 1);
+    sinceCheckpoint = 0;
+    return true;
+}
+
+void benchmarkTransactionLog(int count) {
+    const char* names[] = { "none", "every", "group", "async" };
+    SyncMode modes[] = { SYNC_NONE, SYNC_EVERY, SYNC_GROUP, SYNC_ASYNC };
+    const int threadCounts[] = { 1, 8 };
+
+    for (int threads : threadCounts) {
+        for (int m = 0; m < 4; m++) {
+            unlink("bench_tx.log");
+            unlink("bench_tx.ckpt");
+
+            // Each thread logs its share of the postings and waits for each
+            // to be durable; the checkpoints save the ledger as it stands
+            auto start = std::chrono::steady_clock::now();
+            {
+                Ledger ledger;
+                TransactionLog log("bench_tx.log", "bench_tx.ckpt", modes[m], 10000);
+                log.recover(ledger);
+                std::vector<std::thread> workers;
+                for (int t = 0; t < threads; t++) {
+                    workers.emplace_back([&, t]() {
+                        for (int i = t; i < count; i += threads) {
+                            uint64_t account = 1 + i % 100;
+                            if (i % 2 == 0) log.append(REC_DEPOSIT, account, Money(1000), ledger);
+                            else log.append(REC_WITHDRAW, account, Money(500), ledger);
+                        }
+                    });
+                }
+                for (auto& w : workers) w.join();
+            }
+            auto end = std::chrono::steady_clock::now();
+            double seconds = std::chrono::duration<double>(end - start).count();
+
+            std::cout << "sync=" << std::setw(7) << std::left << names[m] << "threads=" << std::setw(3) << threads
+                << std::right << std::fixed << std::setprecision(0) << count / seconds << " tx/s\n";
+        }
+    }
+    unlink("bench_tx.log");
+    unlink("bench_tx.ckpt");
+}
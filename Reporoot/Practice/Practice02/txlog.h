@@ -0,0 +1,87 @@
+#ifndef TXLOG_H
+#define TXLOG_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "ledger.h"
+#include "persist.h"
+
+// How often appended records are forced to disk. In every mode but
+// SYNC_NONE, append returns only once its record is durable. Group and
+// async commit share one sync between the threads appending at the same
+// time; a single thread appending alone still pays one sync per record.
+enum SyncMode {
+    SYNC_NONE,   // leave it to the OS
+    SYNC_EVERY,  // fsync after every record
+    SYNC_GROUP,  // one fsync covers every record written while the last one ran
+    SYNC_ASYNC   // hand records to a DurablePipeline, wait for its batch to be durable
+};
+
+enum RecordType : uint8_t {
+    REC_DEPOSIT = 1,
+    REC_WITHDRAW = 2
+};
+
+// Append-only binary log of balance changes with CRC-checked records.
+// The checkpoint is a ledger snapshot tagged with the sequence number it
+// covers; recovery maps the snapshot and replays the log tail after it.
+// append may be called from several threads at once. A checkpoint saves the
+// ledger as it is, so threads sharing a ledger should turn off automatic
+// checkpoints and call checkpoint() while no one else is posting.
+class TransactionLog {
+private:
+    std::string logFile;
+    std::string checkpointFile;
+    SyncMode mode;
+    int checkpointEvery;
+
+    int fd;
+    uint64_t nextSeq;
+    int sinceCheckpoint;
+    std::unique_ptr<DurablePipeline> pipeline;  // only in SYNC_ASYNC mode
+
+    std::mutex lock;
+    std::condition_variable synced;
+    uint64_t writtenSeq;  // last record written to the file
+    uint64_t durableSeq;  // last record known to be on disk
+    bool syncing;         // a thread is in fdatasync for the others
+
+    bool syncThrough(std::unique_lock<std::mutex>& guard, uint64_t seq);
+    bool writeCheckpoint(const Ledger& ledger);  // with lock held
+
+public:
+    TransactionLog(const std::string& logFile, const std::string& checkpointFile,
+        SyncMode mode = SYNC_EVERY, int checkpointEvery = 1000);
+    ~TransactionLog();
+
+    // Rebuild the ledger from checkpoint + log, drops a torn tail if there is one.
+    // Returns false if there was no checkpoint, in which case the log is replayed onto ledger as given.
+    bool recover(Ledger& ledger);
+
+    // Log one transaction, checkpoints on its own every checkpointEvery records
+    // (never if it is 0). Returns once the record is durable under the sync mode.
+    bool append(RecordType type, uint64_t account, Money amount, const Ledger& ledger);
+
+    // Force written records to disk
+    void sync();
+
+    // Write a compacted checkpoint of the ledger and empty the log
+    bool checkpoint(const Ledger& ledger);
+
+    // The last sequence number handed out. After recover, the last one the
+    // checkpoint and log cover.
+    uint64_t lastSequence();
+
+    // Hand out a sequence number with no record behind it, for a change to
+    // the ledger that the next checkpoint will cover
+    uint64_t reserveSequence();
+};
+
+// Time count transactions under each sync mode, from one thread and from
+// several, and print transactions per second
+void benchmarkTransactionLog(int count);
+
+#endif
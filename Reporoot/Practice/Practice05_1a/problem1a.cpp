@@ -1,27 +1,19 @@
 #include <iostream>
-#include <vector>
+#include <unistd.h>
+#include "../common/flow.h"
 
 int main() {
-    std::vector<int> numbers;
-    int num;
-
-    std::cout << "Enter integers (enter -1 to stop): ";
-    while (std::cin >> num && num != -1) {
-        numbers.push_back(num);
-    }
+    std::cout << "Enter integers (enter -1 to stop): " << std::flush;
 
+    // One pass over the input echoes each number and adds up the even ones
+    Reduction even_sum = { 0, false };
     std::cout << "Numbers entered: ";
-    for (auto it = numbers.begin(); it != numbers.end(); ++it) {
-        std::cout << *it << " ";
-    }
+    flow::run(STDIN_FILENO, flow::tee(
+        [](int x) { std::cout << x << " "; },
+        flow::filter([](int x) { return x % 2 == 0; }) | flow::sumInto(even_sum)));
     std::cout << std::endl;
 
-    int even_sum = 0;
-    for (auto it = numbers.begin(); it != numbers.end(); ++it) {
-        if (*it % 2 == 0)
-            even_sum += *it;
-    }
     std::cout << "Sum of even numbers: " << even_sum << std::endl;
 
     return 0;
-}
\ No newline at end of file
+}
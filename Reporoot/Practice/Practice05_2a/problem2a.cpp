@@ -1,21 +1,16 @@
 #include <iostream>
-#include <vector>
-#include <numeric> // for std::accumulate
+#include <unistd.h>
+#include "../common/flow.h"
 
 int main() {
-    std::vector<int> numbers;
-    int num;
+    std::cout << "Enter integers (enter -1 to stop): " << std::flush;
 
-    std::cout << "Enter integers (enter -1 to stop): ";
-    while (std::cin >> num && num != -1) {
-        numbers.push_back(num);
-    }
-
-    int sum = std::accumulate(numbers.begin(), numbers.end(), 0);
-    int product = std::accumulate(numbers.begin(), numbers.end(), 1, std::multiplies<int>());
+    Reduction sum = { 0, false };
+    Reduction product = { 1, false };
+    flow::run(STDIN_FILENO, flow::tee(flow::sumInto(sum), flow::productInto(product)));
 
     std::cout << "Sum: " << sum << std::endl;
     std::cout << "Product: " << product << std::endl;
 
     return 0;
-}
\ No newline at end of file
+}
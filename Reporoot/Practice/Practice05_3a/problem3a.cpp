@@ -1,28 +1,39 @@
+#include <charconv>
 #include <iostream>
-#include <vector>
-#include <algorithm> // for for_each
-#include <numeric>   // for accumulate
+#include <string>
+#include <unistd.h>
+#include "../common/flow.h"
 
-int main() {
-    std::vector<int> numbers;
-    int num;
+// A whole number from the command line, or a usage error
+template <typename T>
+bool parseArgument(const std::string& text, T& value) {
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (result.ec == std::errc() && result.ptr == text.data() + text.size()) return true;
+    std::cerr << "Invalid number '" << text << "'\n";
+    return false;
+}
 
-    std::cout << "Enter integers (enter -1 to stop): ";
-    while (std::cin >> num && num != -1) {
-        numbers.push_back(num);
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        size_t count = 100000000;
+        if (argc > 2 && !parseArgument(argv[2], count)) {
+            return 1;
+        }
+        flow::benchmarkFlow(count);
+        return 0;
     }
 
+    std::cout << "Enter integers (enter -1 to stop): " << std::flush;
+
+    // One pass over the input prints each square and adds it to the total
+    Reduction sum_of_squares = { 0, false };
     std::cout << "Squares: ";
-    std::for_each(numbers.begin(), numbers.end(), [](int x) {
-        std::cout << (x * x) << " ";
-        });
+    flow::run(STDIN_FILENO, flow::map([](int x) { return (long long)x * x; }) | flow::tee(
+        [](long long square) { std::cout << square << " "; },
+        flow::sumInto(sum_of_squares)));
     std::cout << std::endl;
 
-    int sum_of_squares = std::accumulate(numbers.begin(), numbers.end(), 0, [](int total, int x) {
-        return total + (x * x);
-        });
-
     std::cout << "Sum of squares: " << sum_of_squares << std::endl;
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,126 @@
+#include "allocation.h"
+#include "employee.h"
+#include "loader.h"
+#include "payroll.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <malloc.h>
+#include <unistd.h>
+
+#ifdef COUNT_ALLOCATIONS
+#include <atomic>
+#include <new>
+
+namespace {
+
+std::atomic<long long> allocations(0);
+
+}
+
+// Count every global operator new; the array and nothrow forms forward here
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+long long allocationCount() {
+    return allocations.load(std::memory_order_relaxed);
+}
+#else
+long long allocationCount() {
+    return -1;
+}
+#endif
+
+size_t heapInUse() {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+long peakRssKb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return std::atol(line.c_str() + 6);
+    }
+    return -1;
+}
+
+// Writing 5 to clear_refs resets the peak to the current RSS
+void resetPeakRss() {
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+}
+
+void benchmarkAllocation(size_t count) {
+    const char* file = "bench_allocation.txt";
+    writeSyntheticRoster(file, count);
+
+    MappedFile mapped;
+    if (!mapped.open(file)) {
+        std::cerr << "Error: Cannot open file '" << file << "'\n";
+        return;
+    }
+    std::vector<EmployeeRecord> records;
+    std::vector<LoadError> errors;
+    records.reserve(count);
+    parseRoster(mapped.text(), records, errors);
+
+    std::cout << "allocation over " << records.size() << " employees";
+    if (allocationCount() < 0) std::cout << " (build with -DCOUNT_ALLOCATIONS to count calls)";
+    std::cout << "\n";
+
+    // Time, allocation calls and peak RSS of build and free together, and
+    // the heap the built roster holds. build calls held() before freeing.
+    auto measure = [&](const char* name, auto build) {
+        resetPeakRss();
+        long rssBefore = peakRssKb();
+        long long allocsBefore = allocationCount();
+        size_t heapBefore = heapInUse();
+        size_t heapHeld = 0;
+        auto start = std::chrono::steady_clock::now();
+        build([&]() { heapHeld = heapInUse() - heapBefore; });
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << std::setw(16) << std::left << name << std::right << std::fixed << std::setprecision(3)
+            << seconds << " s  ";
+        if (allocsBefore >= 0) std::cout << std::setw(10) << allocationCount() - allocsBefore << " allocations  ";
+        std::cout << "heap " << heapHeld / (1024 * 1024) << " MiB  peak +" << (peakRssKb() - rssBefore) / 1024
+            << " MiB\n";
+    };
+
+    measure("new/delete", [&](auto held) {
+        std::vector<Employee*> employees;
+        employees.reserve(records.size());
+        for (const auto& r : records) {
+            std::string name(r.name);
+            if (r.type == SALARIED) employees.push_back(new SalariedEmployee(name, r.id, r.amount));
+            else if (r.type == HOURLY) employees.push_back(new HourlyEmployee(name, r.id, r.amount, r.hours));
+            else employees.push_back(new CommissionEmployee(name, r.id, r.amount, r.sales, r.rate));
+        }
+        held();
+        for (auto emp : employees) delete emp;
+    });
+
+    measure("payroll store", [&](auto held) {
+        PayrollStore store;
+        store.reserve(records.size());
+        for (const auto& r : records) store.add(r);
+        held();
+    });
+
+    unlink(file);
+}
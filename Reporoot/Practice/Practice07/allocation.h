@@ -0,0 +1,28 @@
+#ifndef ALLOCATION_H
+#define ALLOCATION_H
+
+#include <cstddef>
+
+// A payroll run keeps no employee objects: PayrollStore holds every record
+// in per-type columns and every name in one table, so a run allocates only
+// when a column grows rather than once per employee, and frees everything
+// when the store goes away.
+
+// Calls to global operator new since the program started, or -1 unless it
+// was built with -DCOUNT_ALLOCATIONS. The count replaces operator new, so
+// it belongs in a benchmark build only.
+long long allocationCount();
+
+// Bytes malloc has handed out and not yet had back
+size_t heapInUse();
+
+// Peak resident set size in KiB since start or the last resetPeakRss()
+long peakRssKb();
+void resetPeakRss();
+
+// Build and free count employees from a synthetic roster as Employee
+// objects with new/delete and in a PayrollStore, reporting allocations,
+// heap held and peak RSS
+void benchmarkAllocation(size_t count);
+
+#endif
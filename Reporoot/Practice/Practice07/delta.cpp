@@ -0,0 +1,318 @@
+#include "delta.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+
+// The log is feed lines after a line naming the snapshot they follow; every
+// run's changes end with an END line, so a torn run is ignored as a whole
+const char* END_LINE = "# end\n";
+
+std::string logHeader(uint64_t generation) {
+    return "# snapshot " + std::to_string(generation) + "\n";
+}
+
+// Something no earlier snapshot can have used
+uint64_t newGeneration(uint64_t previous) {
+    uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return now > previous ? now : previous + 1;
+}
+
+bool writeAt(int fd, const std::string& text, off_t offset) {
+    const char* p = text.data();
+    size_t len = text.size();
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, offset);
+        if (n < 0) return false;
+        p += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+}
+
+PayrollEngine::PayrollEngine(PayrollStore& store, EngineState& state)
+    : store(store), state(state), logged(0), logBytes(0) {
+    if (state.ready) return;
+
+    // Growing a column copies all of it, so make room up front for the
+    // changes to come rather than in the middle of a delta
+    size_t headroom = snapshotHeadroom(store.size());
+    store.reserveGrowth(headroom);
+
+    PayrollTotals t = store.totals();
+    state.running[SALARIED] = { t.salaried, 0.0 };
+    state.running[HOURLY] = { t.hourly, 0.0 };
+    state.running[COMMISSION] = { t.commission, 0.0 };
+
+    state.index.reserve(store.size() + headroom);
+    for (size_t i = 0; i < store.size(); i++) {
+        if (store.live(i)) state.index.insert(store.at(i).getId(), i);
+    }
+    state.ready = true;
+}
+
+// Count the pay of the employee now at position, whose row may be new
+void PayrollEngine::track(size_t position) {
+    RosterSlot slot = store.fileOrder()[position];
+    state.running[slot.type].add(store.at(position).calculateSalary());
+}
+
+bool PayrollEngine::apply(const DeltaRecord& change) {
+    const EmployeeRecord& r = change.employee;
+    uint32_t position;
+    bool known = state.index.find(r.id, position);
+
+    if (change.op == DELTA_ADD) {
+        if (known || r.id == IdIndex::EMPTY_ID) return false;
+        size_t added = store.add(r);
+        state.index.insert(r.id, added);
+        track(added);
+        return true;
+    }
+    if (!known) return false;
+
+    // Take the old pay out before the row changes or goes away
+    RosterSlot slot = store.fileOrder()[position];
+    state.running[slot.type].add(-store.at(position).calculateSalary());
+
+    if (change.op == DELTA_UPDATE) {
+        store.replace(position, r);
+        track(position);
+    }
+    else {
+        store.remove(position);
+        state.index.erase(r.id);
+    }
+    return true;
+}
+
+void PayrollEngine::apply(const std::vector<DeltaRecord>& changes, DeltaSummary& summary) {
+    for (const auto& change : changes) {
+        if (!apply(change)) summary.rejected++;
+        else if (change.op == DELTA_ADD) summary.added++;
+        else if (change.op == DELTA_UPDATE) summary.updated++;
+        else summary.removed++;
+    }
+}
+
+bool PayrollEngine::replayLog(const std::string& logFile) {
+    logged = 0;
+    logBytes = 0;
+    if (state.generation == 0) return true;
+
+    std::ifstream in(logFile, std::ios::binary);
+    if (!in) return errno == ENOENT;
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (in.bad()) return false;
+
+    // A log left behind by an earlier snapshot is stale
+    std::string header = logHeader(state.generation);
+    if (text.compare(0, header.size(), header) != 0) return true;
+
+    size_t end = text.rfind(END_LINE);
+    logBytes = end == std::string::npos || end < header.size() ? header.size() : end + strlen(END_LINE);
+
+    std::vector<DeltaRecord> changes;
+    std::vector<LoadError> errors;
+    parseDelta(std::string_view(text).substr(header.size(), logBytes - header.size()), changes, errors);
+    DeltaSummary summary;
+    apply(changes, summary);
+    logged = changes.size();
+    return true;
+}
+
+bool PayrollEngine::persist(const std::string& snapshotFile, const std::string& logFile, const RosterStamp& stamp,
+    const std::vector<DeltaRecord>& changes) {
+    if (changes.empty()) return true;
+
+    // A long log makes every load replay it, and a store that no longer fits
+    // its snapshot is copied out of the mapping on every load, so both are
+    // folded into a new snapshot, as is a store that has none
+    if (state.generation == 0 || !store.inSnapshot() || logged + changes.size() > snapshotHeadroom(store.size())) {
+        state.index.reserve(store.size() + snapshotHeadroom(store.size()));
+        uint64_t previous = state.generation;
+        state.generation = newGeneration(previous);
+        const PayrollStore* stores[1] = { &store };
+        if (!PayrollStore::saveSnapshot(snapshotFile, stamp, stores, 1, &state)) {
+            state.generation = previous;
+            return false;
+        }
+        unlink(logFile.c_str());
+        logged = 0;
+        logBytes = 0;
+        return true;
+    }
+
+    std::string text = logBytes == 0 ? logHeader(state.generation) : std::string();
+    for (const auto& change : changes) formatDelta(change, text);
+    text += END_LINE;
+
+    // Cut off whatever a torn run or an older snapshot left after logBytes
+    int fd = open(logFile.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) return false;
+    bool ok = ftruncate(fd, logBytes) == 0 && writeAt(fd, text, logBytes) && fdatasync(fd) == 0;
+    close(fd);
+    if (!ok) return false;
+    logBytes += text.size();
+    logged += changes.size();
+    return true;
+}
+
+bool PayrollEngine::find(int id, size_t& position) const {
+    uint32_t p;
+    if (!state.index.find(id, p)) return false;
+    position = p;
+    return true;
+}
+
+double PayrollEngine::salary(size_t position) const {
+    return store.live(position) ? store.at(position).calculateSalary() : 0.0;
+}
+
+PayrollTotals PayrollEngine::totals() const {
+    PayrollTotals t;
+    t.salaried = state.running[SALARIED].value();
+    t.hourly = state.running[HOURLY].value();
+    t.commission = state.running[COMMISSION].value();
+    return t;
+}
+
+void benchmarkDelta(size_t count, double fraction) {
+    const char* roster = "bench_delta.txt";
+    const char* snapshot = "bench_delta.snap";
+    const char* log = "bench_delta.changes";
+    writeSyntheticRoster(roster, count);
+    RosterStamp stamp;
+    stampRoster(roster, stamp);
+
+    auto seconds = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // The roster as the first run finds it: a snapshot with engine state
+    std::vector<std::string> feeds;
+    size_t changes = std::max<size_t>(1, count * fraction);
+    {
+        PayrollStore store;
+        MappedFile mapped;
+        if (!mapped.open(roster)) {
+            std::cerr << "Error: Cannot open file '" << roster << "'\n";
+            return;
+        }
+        std::vector<EmployeeRecord> records;
+        std::vector<LoadError> errors;
+        records.reserve(count);
+        parseRoster(mapped.text(), records, errors);
+        store.reserve(records.size());
+        for (const auto& r : records) store.add(r);
+        EngineState state;
+        PayrollEngine engine(store, state);
+        state.generation = 1;
+        const PayrollStore* stores[1] = { &store };
+        PayrollStore::saveSnapshot(snapshot, stamp, stores, 1, &state);
+        unlink(log);
+
+        // Mostly hours and pay updates, with some hires and departures
+        std::mt19937 rng(9);
+        for (int f = 0; f < 4; f++) {
+            std::string feed;
+            for (size_t i = 0; i < changes; i++) {
+                size_t position = rng() % store.size();
+                EmployeeView e = store.at(position);
+                std::string id = std::to_string(e.getId());
+                std::string name(e.getName());
+                switch (rng() % 10) {
+                case 0:
+                    feed += "add Hourly " + std::to_string(900000000 + f * changes + i) + " New" + std::to_string(i)
+                        + " 21.50 160\n";
+                    break;
+                case 1: feed += "remove " + id + "\n"; break;
+                default:
+                    if (e.getType() == SALARIED)
+                        feed += "update Salaried " + id + " " + name + " " + std::to_string(3000 + rng() % 5000) + "\n";
+                    else if (e.getType() == HOURLY)
+                        feed += "update Hourly " + id + " " + name + " "
+                            + std::to_string(store.hourly.hourlyRate[store.fileOrder()[position].row])
+                            + " " + std::to_string(80 + rng() % 100) + "\n";
+                    else
+                        feed += "update Commission " + id + " " + name + " 1500 " + std::to_string(rng() % 50000)
+                            + " 0.05\n";
+                }
+            }
+            feeds.push_back(feed);
+        }
+    }
+
+    // One --delta run: load the roster, apply the feed, keep the changes
+    auto run = [&](const std::string& feed, bool withState, DeltaSummary& summary, size_t& logged) {
+        PayrollStore store;
+        EngineState state;
+        store.loadSnapshot(snapshot, stamp, withState ? &state : nullptr);
+        PayrollEngine engine(store, state);
+        engine.replayLog(log);
+
+        std::vector<DeltaRecord> delta, applied;
+        std::vector<LoadError> errors;
+        parseDelta(feed, delta, errors);
+        for (const auto& change : delta) {
+            if (!engine.apply(change)) summary.rejected++;
+            else applied.push_back(change);
+        }
+        engine.persist(snapshot, log, stamp, applied);
+        logged = engine.loggedChanges();
+        return engine.totals();
+    };
+
+    std::cout << "delta of " << changes << " changes over " << count << " employees, load to saved\n"
+        << std::fixed << std::setprecision(3);
+
+    // Without the saved state every run walks the whole store and, having no
+    // log to add to, writes the whole store back
+    DeltaSummary summary;
+    size_t logged;
+    auto start = std::chrono::steady_clock::now();
+    run(feeds[0], false, summary, logged);
+    double rebuild = seconds(start);
+    std::cout << "rebuild run       " << rebuild * 1000 << " ms  (new snapshot)\n";
+
+    double slowest = 0.0;
+    PayrollTotals incremental;
+    for (size_t f = 1; f < feeds.size(); f++) {
+        start = std::chrono::steady_clock::now();
+        incremental = run(feeds[f], true, summary, logged);
+        double secs = seconds(start);
+        slowest = std::max(slowest, secs);
+        std::cout << "delta run " << f << "       " << secs * 1000 << " ms  (" << logged << " changes in the log)\n";
+    }
+
+    // The saved state and log give the same payroll as a full recompute
+    PayrollStore store;
+    EngineState state;
+    store.loadSnapshot(snapshot, stamp, &state);
+    PayrollEngine(store, state).replayLog(log);
+    start = std::chrono::steady_clock::now();
+    PayrollTotals full = store.totals();
+    double fullRun = seconds(start);
+
+    std::cout << "full recompute    " << fullRun * 1000 << " ms  (totals only)\n"
+        << std::setprecision(1) << "speedup           " << rebuild / slowest << "x over rebuilding\n"
+        << std::setprecision(2) << "totals            $" << incremental.total() << " incremental, $"
+        << full.total() << " recomputed, " << summary.rejected << " changes rejected\n";
+
+    unlink(roster);
+    unlink(snapshot);
+    unlink(log);
+}
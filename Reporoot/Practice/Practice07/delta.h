@@ -0,0 +1,65 @@
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "loader.h"
+#include "payroll.h"
+
+struct DeltaSummary {
+    size_t added = 0;
+    size_t updated = 0;
+    size_t removed = 0;
+    size_t rejected = 0;  // add of a known id, or update/remove of an unknown one
+};
+
+// Payroll kept current as the roster changes. The engine works on a store
+// and the EngineState beside it. Building that state walks the store once
+// and reserves room to grow; a state loaded with a snapshot is ready as it
+// is. After that a change costs O(1) expected, touching only its row.
+// With duplicate ids in the roster, changes go to the first one.
+//
+// Applied changes are kept in a change log tied to the snapshot they
+// follow, so a run writes only its own changes. Once the log holds as many
+// changes as the snapshot has headroom, or the store has outgrown the
+// snapshot, the changes go into a fresh snapshot and the log starts over.
+class PayrollEngine {
+public:
+    PayrollEngine(PayrollStore& store, EngineState& state);
+
+    // Apply one change to the store and the totals
+    bool apply(const DeltaRecord& change);
+    void apply(const std::vector<DeltaRecord>& changes, DeltaSummary& summary);
+
+    // Apply the changes logged since the snapshot the state came from.
+    // False if the log is there but can't be read.
+    bool replayLog(const std::string& logFile);
+
+    // Keep changes, already applied, for the next run: append them to the
+    // log, or write the store to a new snapshot stamped with stamp
+    bool persist(const std::string& snapshotFile, const std::string& logFile, const RosterStamp& stamp,
+        const std::vector<DeltaRecord>& changes);
+
+    bool find(int id, size_t& position) const;
+    double salary(size_t position) const;
+    PayrollTotals totals() const;
+
+    // Changes in the log after the snapshot
+    size_t loggedChanges() const { return logged; }
+
+private:
+    PayrollStore& store;
+    EngineState& state;
+    size_t logged;
+    size_t logBytes;  // length of the log up to its last complete run
+
+    void track(size_t position);
+};
+
+// Time a --delta run end to end (load, apply, keep the changes) with the
+// engine state from the snapshot against rebuilding it, for deltas that
+// touch fraction of count employees
+void benchmarkDelta(size_t count, double fraction);
+
+#endif
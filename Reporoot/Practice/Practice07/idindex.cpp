@@ -0,0 +1,90 @@
+#include "idindex.h"
+
+namespace {
+
+size_t mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x45d9f3bu;
+    x ^= x >> 16;
+    x *= 0x45d9f3bu;
+    x ^= x >> 16;
+    return x;
+}
+
+}
+
+// Slot holding id, or the empty slot where it would go
+size_t IdIndex::probe(int id) const {
+    size_t mask = slots - 1;
+    size_t i = mix((uint32_t)id) & mask;
+    while (table[i].id != id && table[i].id != EMPTY_ID) i = (i + 1) & mask;
+    return i;
+}
+
+void IdIndex::attach(Entry* data, size_t n, size_t used) {
+    std::vector<Entry>().swap(owned);
+    table = data;
+    slots = n;
+    count = used;
+}
+
+void IdIndex::rehash(size_t capacity) {
+    std::vector<Entry> old(capacity, { EMPTY_ID, 0 });
+    old.swap(owned);
+    Entry* previous = table;
+    size_t previousSlots = slots;
+    table = owned.data();
+    slots = capacity;
+    for (size_t i = 0; i < previousSlots; i++) {
+        if (previous[i].id != EMPTY_ID) table[probe(previous[i].id)] = previous[i];
+    }
+}
+
+void IdIndex::reserve(size_t n) {
+    size_t capacity = slots;
+    while (n * 10 > capacity * 7) capacity *= 2;
+    if (capacity != slots) rehash(capacity);
+}
+
+bool IdIndex::insert(int id, uint32_t position) {
+    if (id == EMPTY_ID) return false;
+    size_t i = probe(id);
+    if (table[i].id == id) return false;
+
+    // Keep the load factor under 0.7 so probe runs stay short
+    if ((count + 1) * 10 > slots * 7) {
+        rehash(slots * 2);
+        i = probe(id);
+    }
+    table[i] = { id, position };
+    count++;
+    return true;
+}
+
+bool IdIndex::find(int id, uint32_t& position) const {
+    if (id == EMPTY_ID) return false;
+    const Entry& e = table[probe(id)];
+    if (e.id != id) return false;
+    position = e.position;
+    return true;
+}
+
+bool IdIndex::erase(int id) {
+    if (id == EMPTY_ID) return false;
+    size_t mask = slots - 1;
+    size_t hole = probe(id);
+    if (table[hole].id != id) return false;
+
+    // Pull later entries of the run back over the hole, unless that would
+    // move one in front of its home slot
+    for (size_t i = (hole + 1) & mask; table[i].id != EMPTY_ID; i = (i + 1) & mask) {
+        size_t home = mix((uint32_t)table[i].id) & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            table[hole] = table[i];
+            hole = i;
+        }
+    }
+    table[hole].id = EMPTY_ID;
+    count--;
+    return true;
+}
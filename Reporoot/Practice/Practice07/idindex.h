@@ -0,0 +1,50 @@
+#ifndef IDINDEX_H
+#define IDINDEX_H
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Open-addressing hash map from employee id to position in a PayrollStore,
+// with linear probing and backward-shift deletion. The table can also live
+// in memory owned by someone else, such as a snapshot mapping.
+class IdIndex {
+public:
+    static const int EMPTY_ID = INT_MIN;
+
+    struct Entry {
+        int id;
+        uint32_t position;
+    };
+
+    IdIndex() : owned(16, { EMPTY_ID, 0 }), table(owned.data()), slots(16), count(0) {}
+    IdIndex(const IdIndex&) = delete;
+    IdIndex& operator=(const IdIndex&) = delete;
+    IdIndex(IdIndex&&) = default;
+    IdIndex& operator=(IdIndex&&) = default;
+
+    // Use slots entries at data, count of them in use, in place. The table
+    // is copied out only when it has to grow.
+    void attach(Entry* data, size_t slots, size_t count);
+    const Entry* data() const { return table; }
+    size_t capacity() const { return slots; }
+
+    void reserve(size_t n);
+    // False if id is already present or is EMPTY_ID
+    bool insert(int id, uint32_t position);
+    bool find(int id, uint32_t& position) const;
+    bool erase(int id);
+    size_t size() const { return count; }
+
+private:
+    std::vector<Entry> owned;
+    Entry* table;  // owned.data() unless attached
+    size_t slots;  // a power of two
+    size_t count;
+
+    size_t probe(int id) const;
+    void rehash(size_t capacity);
+};
+
+#endif
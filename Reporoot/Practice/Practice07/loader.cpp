@@ -0,0 +1,312 @@
+#include "loader.h"
+#include "employee.h"
+#include "idindex.h"
+#include <charconv>
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+// Splits one line into whitespace separated tokens and remembers where they start
+class LineScanner {
+private:
+    const char* lineStart;
+    const char* p;
+    const char* end;
+
+public:
+    LineScanner(const char* begin, const char* end) : lineStart(begin), p(begin), end(end) {}
+
+    bool next(std::string_view& token) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+        if (p == end) return false;
+        const char* start = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r') p++;
+        token = std::string_view(start, p - start);
+        return true;
+    }
+
+    size_t column(std::string_view token) const { return token.data() - lineStart + 1; }
+    size_t endColumn() const { return end - lineStart + 1; }
+};
+
+template <typename T>
+bool parseNumber(std::string_view token, T& value) {
+    auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+    return result.ec == std::errc() && result.ptr == token.data() + token.size();
+}
+
+// Pay figures must be finite: from_chars reads "nan" and "inf", and a NaN
+// salary would break every ordering built on it
+bool parseNumber(std::string_view token, double& value) {
+    return parseNumber<double>(token, value) && std::isfinite(value);
+}
+
+// The id index marks empty slots with EMPTY_ID, so no employee may have it
+bool parseId(std::string_view token, int& id) {
+    return parseNumber(token, id) && id != IdIndex::EMPTY_ID;
+}
+
+// Fields after the name for each type, in file order
+const char* const FIELD_NAMES[3][3] = {
+    { "salary", nullptr, nullptr },
+    { "hourly rate", "hours", nullptr },
+    { "base salary", "sales", "commission rate" }
+};
+
+}
+
+MappedFile::~MappedFile() {
+    if (mapping) munmap(mapping, length);
+}
+
+bool MappedFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    length = st.st_size;
+    if (length > 0) {
+        void* m = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) {
+            close(fd);
+            length = 0;
+            return false;
+        }
+        madvise(m, length, MADV_SEQUENTIAL);
+        mapping = m;
+    }
+    close(fd);
+    return true;
+}
+
+namespace {
+
+// Parse the rest of an employee line after its type token. On failure one
+// error is added and false returned.
+bool parseEmployee(LineScanner& scan, std::string_view typeToken, size_t lineNo, EmployeeRecord& r,
+    std::vector<LoadError>& errors) {
+    std::string_view token = typeToken;
+    r = {};
+    if (token == "Salaried") r.type = SALARIED;
+    else if (token == "Hourly") r.type = HOURLY;
+    else if (token == "Commission") r.type = COMMISSION;
+    else {
+        errors.push_back({ lineNo, scan.column(token), "unknown employee type '" + std::string(token) + "'" });
+        return false;
+    }
+
+    if (!scan.next(token)) {
+        errors.push_back({ lineNo, scan.endColumn(), "missing id" });
+        return false;
+    }
+    if (!parseId(token, r.id)) {
+        errors.push_back({ lineNo, scan.column(token), "invalid id '" + std::string(token) + "'" });
+        return false;
+    }
+    if (!scan.next(r.name)) {
+        errors.push_back({ lineNo, scan.endColumn(), "missing name" });
+        return false;
+    }
+
+    for (int f = 0; f < 3 && FIELD_NAMES[r.type][f]; f++) {
+        if (!scan.next(token)) {
+            errors.push_back({ lineNo, scan.endColumn(), std::string("missing ") + FIELD_NAMES[r.type][f] });
+            return false;
+        }
+        bool ok;
+        if (r.type == HOURLY && f == 1) ok = parseNumber(token, r.hours);
+        else ok = parseNumber(token, f == 0 ? r.amount : (f == 1 ? r.sales : r.rate));
+        if (!ok) {
+            errors.push_back({ lineNo, scan.column(token),
+                std::string("invalid ") + FIELD_NAMES[r.type][f] + " '" + std::string(token) + "'" });
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reject anything left on the line
+bool expectEnd(LineScanner& scan, size_t lineNo, std::vector<LoadError>& errors) {
+    std::string_view token;
+    if (!scan.next(token)) return true;
+    errors.push_back({ lineNo, scan.column(token), "unexpected '" + std::string(token) + "'" });
+    return false;
+}
+
+}
+
+size_t parseRoster(std::string_view text, std::vector<EmployeeRecord>& out, std::vector<LoadError>& errors) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    size_t lineNo = 0;
+
+    while (p < end) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+        lineNo++;
+
+        LineScanner scan(p, eol);
+        p = eol + 1;
+
+        std::string_view token;
+        if (!scan.next(token)) continue;  // blank line
+
+        EmployeeRecord r;
+        if (parseEmployee(scan, token, lineNo, r, errors) && expectEnd(scan, lineNo, errors)) out.push_back(r);
+    }
+    return lineNo;
+}
+
+size_t parseDelta(std::string_view text, std::vector<DeltaRecord>& out, std::vector<LoadError>& errors) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    size_t lineNo = 0;
+
+    while (p < end) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+        lineNo++;
+
+        LineScanner scan(p, eol);
+        p = eol + 1;
+
+        std::string_view token;
+        if (!scan.next(token) || token[0] == '#') continue;  // blank line or comment
+
+        DeltaRecord d;
+        if (token == "add" || token == "update") {
+            d.op = token == "add" ? DELTA_ADD : DELTA_UPDATE;
+            if (!scan.next(token)) {
+                errors.push_back({ lineNo, scan.endColumn(), "missing employee type" });
+                continue;
+            }
+            if (!parseEmployee(scan, token, lineNo, d.employee, errors)) continue;
+        }
+        else if (token == "remove") {
+            d.op = DELTA_REMOVE;
+            d.employee = {};
+            if (!scan.next(token)) {
+                errors.push_back({ lineNo, scan.endColumn(), "missing id" });
+                continue;
+            }
+            if (!parseId(token, d.employee.id)) {
+                errors.push_back({ lineNo, scan.column(token), "invalid id '" + std::string(token) + "'" });
+                continue;
+            }
+        }
+        else {
+            errors.push_back({ lineNo, scan.column(token), "unknown change '" + std::string(token) + "'" });
+            continue;
+        }
+        if (expectEnd(scan, lineNo, errors)) out.push_back(d);
+    }
+    return lineNo;
+}
+
+void formatDelta(const DeltaRecord& change, std::string& out) {
+    // Shortest round-trip form, so values survive the trip through text unchanged
+    auto put = [&out](auto value) {
+        char text[32];
+        out += ' ';
+        out.append(text, std::to_chars(text, text + sizeof(text), value).ptr);
+    };
+    const EmployeeRecord& r = change.employee;
+    if (change.op == DELTA_REMOVE) {
+        out += "remove";
+        put(r.id);
+        out += '\n';
+        return;
+    }
+    out += change.op == DELTA_ADD ? "add " : "update ";
+    out += r.type == SALARIED ? "Salaried" : (r.type == HOURLY ? "Hourly" : "Commission");
+    put(r.id);
+    out += ' ';
+    out += r.name;
+    put(r.amount);
+    if (r.type == HOURLY) put(r.hours);
+    if (r.type == COMMISSION) {
+        put(r.sales);
+        put(r.rate);
+    }
+    out += '\n';
+}
+
+void writeSyntheticRoster(const char* file, size_t count) {
+    std::ofstream outFile(file);
+    std::mt19937 rng(5);
+    for (size_t i = 0; i < count; i++) {
+        int id = 100000 + (int)i;
+        switch (rng() % 3) {
+        case 0: outFile << "Salaried " << id << " Emp" << i << " " << 3000 + rng() % 5000 << ".00\n"; break;
+        case 1: outFile << "Hourly " << id << " Emp" << i << " " << 15 + rng() % 40 << ".50 " << 80 + rng() % 100 << "\n"; break;
+        default: outFile << "Commission " << id << " Emp" << i << " " << 1000 + rng() % 2000 << ".00 "
+            << rng() % 50000 << ".00 0.0" << 1 + rng() % 9 << "\n";
+        }
+    }
+}
+
+void benchmarkLoader(size_t count) {
+    const char* file = "bench_employees.txt";
+    writeSyntheticRoster(file, count);
+
+    auto report = [&](const char* name, std::chrono::steady_clock::time_point start, size_t records) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << std::setw(18) << std::left << name << std::right << std::fixed << std::setprecision(2)
+            << seconds << " s  " << std::setprecision(1) << records / seconds / 1e6 << "M records/s\n";
+    };
+
+    // The original loader
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::ifstream infile(file);
+        std::vector<Employee*> employees;
+        std::string type, name;
+        int id;
+        while (infile >> type >> id >> name) {
+            if (type == "Salaried") {
+                double salary;
+                infile >> salary;
+                employees.push_back(new SalariedEmployee(name, id, salary));
+            }
+            else if (type == "Hourly") {
+                double rate;
+                int hours;
+                infile >> rate >> hours;
+                employees.push_back(new HourlyEmployee(name, id, rate, hours));
+            }
+            else {
+                double base, sales, rate;
+                infile >> base >> sales >> rate;
+                employees.push_back(new CommissionEmployee(name, id, base, sales, rate));
+            }
+        }
+        report("iostream", start, employees.size());
+        for (auto emp : employees) delete emp;
+    }
+
+    start = std::chrono::steady_clock::now();
+    {
+        MappedFile mapped;
+        mapped.open(file);
+        std::vector<EmployeeRecord> records;
+        std::vector<LoadError> errors;
+        records.reserve(count);
+        parseRoster(mapped.text(), records, errors);
+        report("mmap + from_chars", start, records.size());
+    }
+    unlink(file);
+}
@@ -0,0 +1,82 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum EmployeeType : uint8_t {
+    SALARIED,
+    HOURLY,
+    COMMISSION
+};
+
+// One parsed line of employees.txt. name points into the loaded file.
+struct EmployeeRecord {
+    EmployeeType type;
+    int id;
+    std::string_view name;
+    double amount;  // monthly salary, hourly rate or base salary
+    double sales;   // commission only
+    double rate;    // commission rate, commission only
+    int hours;      // hourly only
+};
+
+enum DeltaOp : uint8_t {
+    DELTA_ADD,
+    DELTA_UPDATE,
+    DELTA_REMOVE
+};
+
+// One line of a roster change feed. Only employee.id is set for a removal.
+struct DeltaRecord {
+    DeltaOp op;
+    EmployeeRecord employee;
+};
+
+struct LoadError {
+    size_t line;
+    size_t column;
+    std::string message;
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+private:
+    void* mapping;
+    size_t length;
+
+public:
+    MappedFile() : mapping(nullptr), length(0) {}
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    std::string_view text() const { return std::string_view(static_cast<const char*>(mapping), length); }
+};
+
+// Tokenize the roster in place, one employee per line, numbers parsed with
+// std::from_chars. Malformed lines are skipped and reported in errors.
+// Returns the number of lines read.
+size_t parseRoster(std::string_view text, std::vector<EmployeeRecord>& out, std::vector<LoadError>& errors);
+
+// Parse a change feed keyed by employee id, one change per line:
+//   add <roster line>
+//   update <roster line>
+//   remove <id>
+// Blank lines and lines starting with '#' are skipped. Returns the number of lines read.
+size_t parseDelta(std::string_view text, std::vector<DeltaRecord>& out, std::vector<LoadError>& errors);
+
+// Append change to out as one feed line that parseDelta reads back exactly
+void formatDelta(const DeltaRecord& change, std::string& out);
+
+// Write count random employees in the employees.txt format
+void writeSyntheticRoster(const char* file, size_t count);
+
+// Write a synthetic roster of count lines and time the iostream loader against parseRoster
+void benchmarkLoader(size_t count);
+
+#endif
@@ -1,126 +1,305 @@
+#include <algorithm>
+#include <charconv>
+#include <iomanip>
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <string>
-#include <iomanip>
+#include <thread>
+#include "allocation.h"
+#include "delta.h"
+#include "loader.h"
+#include "payroll.h"
+#include "pipeline.h"
+#include "query.h"
+#include "report.h"
+#include <unistd.h>
+#include <sys/stat.h>
 
-class Employee {
-protected:
-    std::string name;
-    int id;
-
-public:
-    Employee(std::string name, int id) : name(name), id(id) {}
-    virtual ~Employee() {} // needed for deleting base class pointers
-    virtual double calculateSalary() const = 0;
-    virtual void displayInfo() const = 0;
-};
+// A whole number from the command line, or a usage error
+template <typename T>
+bool parseArgument(const std::string& text, T& value) {
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (result.ec == std::errc() && result.ptr == text.data() + text.size()) return true;
+    std::cerr << "Invalid number '" << text << "'\n";
+    return false;
+}
 
-class SalariedEmployee : public Employee {
-private:
-    double monthlySalary;
+const char* SNAPSHOT_FILE = "employees.snap";
+const char* CHANGE_LOG = "employees.changes";
 
-public:
-    SalariedEmployee(std::string name, int id, double salary)
-        : Employee(name, id), monthlySalary(salary) {}
+// The snapshot --delta runs keep, and their log, hold changes employees.txt
+// does not. Once employees.txt changes the snapshot no longer loads, so
+// rather than drop those changes by rebuilding from the text, stop and say so.
+bool changesWouldBeLost() {
+    struct stat st;
+    if (PayrollStore::snapshotGeneration(SNAPSHOT_FILE) == 0
+        && (stat(CHANGE_LOG, &st) != 0 || st.st_size == 0)) {
+        return false;
+    }
+    std::cerr << "Error: employees.txt has changed since the changes applied with --delta were saved in '"
+        << SNAPSHOT_FILE << "' and '" << CHANGE_LOG << "'\n"
+        << "Restore employees.txt, or move both files aside to start again from it\n";
+    return true;
+}
 
-    double calculateSalary() const override {
-        return monthlySalary;
+// The roster from the snapshot while it is fresh, else from employees.txt.
+// stamp is set to employees.txt's stamp, and state to the engine state
+// saved with the snapshot, if any. Fails rather than drop changes kept by
+// earlier --delta runs.
+bool loadRoster(PayrollStore& store, EngineState& state, RosterStamp& stamp) {
+    if (!stampRoster("employees.txt", stamp)) {
+        std::cerr << "Error: Cannot open file 'employees.txt'\n";
+        return false;
+    }
+    if (store.loadSnapshot(SNAPSHOT_FILE, stamp, &state)) {
+        return true;
     }
+    if (changesWouldBeLost()) {
+        return false;
+    }
+    MappedFile file;
+    if (!file.open("employees.txt")) {
+        std::cerr << "Error: Cannot open file 'employees.txt'\n";
+        return false;
+    }
+    std::vector<EmployeeRecord> records;
+    std::vector<LoadError> errors;
+    parseRoster(file.text(), records, errors);
+    for (const auto& err : errors) {
+        std::cerr << "employees.txt:" << err.line << ":" << err.column << ": " << err.message << "\n";
+    }
+    store.reserve(records.size());
+    for (const auto& r : records) {
+        store.add(r);
+    }
+    return true;
+}
 
-    void displayInfo() const override {
-        std::cout << "ID: " << id << ", Name: " << name
-            << ", Type: Salaried, Monthly Salary: $"
-            << std::fixed << std::setprecision(2) << calculateSalary() << "\n";
+// Bring a snapshot's roster up to date with the change feeds applied since it was written
+bool applyChangeLog(PayrollStore& store, EngineState& state) {
+    if (!state.ready || PayrollEngine(store, state).replayLog(CHANGE_LOG)) {
+        return true;
     }
-};
+    std::cerr << "Error: Cannot read file '" << CHANGE_LOG << "'\n";
+    return false;
+}
 
-class HourlyEmployee : public Employee {
-private:
-    double hourlyRate;
-    int hoursWorked;
+// Apply a change feed to the roster and keep the result, then print only
+// the employees it touched and the new payroll totals
+int runDelta(const std::string& feedFile) {
+    PayrollStore store;
+    EngineState state;
+    RosterStamp stamp;
+    if (!loadRoster(store, state, stamp)) {
+        return 1;
+    }
 
-public:
-    HourlyEmployee(std::string name, int id, double rate, int hours)
-        : Employee(name, id), hourlyRate(rate), hoursWorked(hours) {}
+    MappedFile feed;
+    if (!feed.open(feedFile)) {
+        std::cerr << "Error: Cannot open file '" << feedFile << "'\n";
+        return 1;
+    }
+    std::vector<DeltaRecord> changes;
+    std::vector<LoadError> errors;
+    parseDelta(feed.text(), changes, errors);
+    for (const auto& err : errors) {
+        std::cerr << feedFile << ":" << err.line << ":" << err.column << ": " << err.message << "\n";
+    }
 
-    double calculateSalary() const override {
-        return hourlyRate * hoursWorked;
+    PayrollEngine engine(store, state);
+    if (!engine.replayLog(CHANGE_LOG)) {
+        std::cerr << "Error: Cannot read file '" << CHANGE_LOG << "'\n";
+        return 1;
+    }
+    DeltaSummary summary;
+    std::vector<DeltaRecord> applied;
+    std::cout << "\nChanged Employees:\n";
+    for (const auto& change : changes) {
+        int id = change.employee.id;
+        if (!engine.apply(change)) {
+            std::cerr << "Rejected: " << (change.op == DELTA_ADD ? "add of existing" : "change to unknown")
+                << " ID " << id << "\n";
+            summary.rejected++;
+            continue;
+        }
+        applied.push_back(change);
+        if (change.op == DELTA_REMOVE) {
+            std::cout << "ID: " << id << ", Removed\n";
+            summary.removed++;
+        }
+        else {
+            size_t position;
+            engine.find(id, position);
+            store.at(position).displayInfo();
+            if (change.op == DELTA_ADD) summary.added++;
+            else summary.updated++;
+        }
     }
 
-    void displayInfo() const override {
-        std::cout << "ID: " << id << ", Name: " << name
-            << ", Type: Hourly, Hours Worked: " << hoursWorked
-            << ", Hourly Rate: $" << std::fixed << std::setprecision(2) << hourlyRate
-            << ", Salary: $" << calculateSalary() << "\n";
+    if (!engine.persist(SNAPSHOT_FILE, CHANGE_LOG, stamp, applied)) {
+        std::cerr << "Error: Cannot save the changes\n";
+        return 1;
     }
-};
 
-class CommissionEmployee : public Employee {
-private:
-    double baseSalary;
-    double totalSales;
-    double commissionRate;
+    PayrollTotals totals = engine.totals();
+    std::cout << "\nPayroll Totals:\n" << std::fixed << std::setprecision(2)
+        << "Salaried: $" << totals.salaried << "\n"
+        << "Hourly: $" << totals.hourly << "\n"
+        << "Commission: $" << totals.commission << "\n"
+        << "Total: $" << totals.total() << "\n"
+        << summary.added << " added, " << summary.updated << " updated, " << summary.removed << " removed, "
+        << summary.rejected << " rejected\n";
+    return 0;
+}
 
-public:
-    CommissionEmployee(std::string name, int id, double base, double sales, double rate)
-        : Employee(name, id), baseSalary(base), totalSales(sales), commissionRate(rate) {}
+// Answer one query over the roster: --top N, --id ID, --prefix TEXT or --percentiles
+int runQuery(const std::string& query, const std::string& argument) {
+    size_t top = 0;
+    int id = 0;
+    if ((query == "--top" && !parseArgument(argument, top)) || (query == "--id" && !parseArgument(argument, id))) {
+        return 1;
+    }
 
-    double calculateSalary() const override {
-        return baseSalary + (totalSales * commissionRate);
+    PayrollStore store;
+    EngineState state;
+    RosterStamp stamp;
+    if (!loadRoster(store, state, stamp) || !applyChangeLog(store, state)) {
+        return 1;
     }
+    PayrollIndex index(store);
 
-    void displayInfo() const override {
-        std::cout << "ID: " << id << ", Name: " << name
-            << ", Type: Commission, Base: $" << baseSalary
-            << ", Sales: $" << totalSales
-            << ", Rate: " << commissionRate
-            << ", Salary: $" << std::fixed << std::setprecision(2) << calculateSalary() << "\n";
+    if (query == "--percentiles") {
+        const char* types[3] = { "Salaried", "Hourly", "Commission" };
+        std::cout << "\nSalary Percentiles:\n" << std::fixed << std::setprecision(2);
+        for (int t = SALARIED; t <= COMMISSION; t++) {
+            std::cout << types[t] << " (" << index.count((EmployeeType)t) << ")";
+            for (double p : { 50.0, 90.0, 99.0 }) {
+                double salary;
+                if (index.percentile((EmployeeType)t, p, salary)) {
+                    std::cout << ", p" << (int)p << ": $" << salary;
+                }
+            }
+            std::cout << "\n";
+        }
+        return 0;
     }
-};
 
-int main() {
-    std::ifstream infile("employees.txt");
-    if (!infile) {
-        std::cerr << "Error: Cannot open file 'employees.txt'\n";
-        return 1;
+    std::vector<uint32_t> positions;
+    if (query == "--top") {
+        std::vector<PayEntry> earners;
+        index.topEarners(top, earners);
+        for (const auto& e : earners) {
+            positions.push_back(e.position);
+        }
+    }
+    else if (query == "--id") {
+        size_t position;
+        if (index.findId(id, position)) {
+            positions.push_back(position);
+        }
+    }
+    else {
+        index.namePrefix(argument, positions);
     }
 
-    std::vector<Employee*> employees;
-    std::string type;
-    int id;
-    std::string name;
+    ReportWriter writer(STDOUT_FILENO, REPORT_TEXT);
+    writer.begin();
+    for (uint32_t position : positions) {
+        writer.add(store, position);
+    }
+    return writer.flush() ? 0 : 1;
+}
 
-    while (infile >> type >> id >> name) {
-        if (type == "Salaried") {
-            double salary;
-            infile >> salary;
-            employees.push_back(new SalariedEmployee(name, id, salary));
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        size_t count = 10000000;
+        if (argc > 2 && !parseArgument(argv[2], count)) {
+            return 1;
         }
-        else if (type == "Hourly") {
-            double rate;
-            int hours;
-            infile >> rate >> hours;
-            employees.push_back(new HourlyEmployee(name, id, rate, hours));
+        benchmarkLoader(count);
+        benchmarkPayroll(count);
+        benchmarkAllocation(count);
+        benchmarkSnapshot(count);
+        benchmarkDelta(count, 0.001);
+        benchmarkReport(count);
+        benchmarkQueries(count);
+        benchmarkPipeline(count, std::max(8u, std::thread::hardware_concurrency()));
+        return 0;
+    }
+    if (argc > 2 && std::string(argv[1]) == "--delta") {
+        return runDelta(argv[2]);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--percentiles") {
+        return runQuery(argv[1], "");
+    }
+    if (argc > 2 && (std::string(argv[1]) == "--top" || std::string(argv[1]) == "--id"
+            || std::string(argv[1]) == "--prefix")) {
+        return runQuery(argv[1], argv[2]);
+    }
+
+    ReportFormat format = REPORT_TEXT;
+    if (argc > 2 && std::string(argv[1]) == "--format") {
+        std::string name = argv[2];
+        if (name == "csv") format = REPORT_CSV;
+        else if (name == "binary") format = REPORT_BINARY;
+        else if (name != "text") {
+            std::cerr << "Unknown format '" << name << "' (text, csv or binary)\n";
+            return 1;
         }
-        else if (type == "Commission") {
-            double base, sales, rate;
-            infile >> base >> sales >> rate;
-            employees.push_back(new CommissionEmployee(name, id, base, sales, rate));
+    }
+
+    // Reuse the binary snapshot, and the changes since, while it matches employees.txt
+    RosterStamp stamp;
+    bool stamped = stampRoster("employees.txt", stamp);
+    PayrollStore snapshot;
+    EngineState state;
+    if (stamped && snapshot.loadSnapshot(SNAPSHOT_FILE, stamp, &state)) {
+        if (!applyChangeLog(snapshot, state)) {
+            return 1;
         }
-        else {
-            std::cerr << "Unknown employee type: " << type << "\n";
+        ReportWriter writer(STDOUT_FILENO, format);
+        writer.begin();
+        for (size_t i = 0; i < snapshot.size(); i++) {
+            writer.add(snapshot, i);
         }
+        return writer.flush() ? 0 : 1;
+    }
+    if (stamped && changesWouldBeLost()) {
+        return 1;
     }
 
-    std::cout << "\nEmployee Info:\n";
-    for (const auto& emp : employees) {
-        emp->displayInfo();
+    MappedFile file;
+    if (!file.open("employees.txt")) {
+        std::cerr << "Error: Cannot open file 'employees.txt'\n";
+        return 1;
     }
 
-    for (auto emp : employees) {
-        delete emp;
+    std::vector<RosterChunk> chunks;
+    PayrollSummary summary;
+    runPayroll(file.text(), std::thread::hardware_concurrency(), chunks, summary);
+    bool clean = true;
+    for (const auto& chunk : chunks) {
+        for (const auto& err : chunk.errors) {
+            std::cerr << "employees.txt:" << err.line << ":" << err.column << ": " << err.message << "\n";
+            clean = false;
+        }
     }
 
-    return 0;
+    // Only a roster that loaded cleanly is snapshotted, so errors keep being reported
+    if (stamped && clean) {
+        std::vector<const PayrollStore*> stores;
+        for (const auto& chunk : chunks) {
+            stores.push_back(&chunk.store);
+        }
+        PayrollStore::saveSnapshot(SNAPSHOT_FILE, stamp, stores.data(), stores.size());
+    }
+
+    ReportWriter writer(STDOUT_FILENO, format);
+    writer.begin();
+    for (const auto& chunk : chunks) {
+        for (size_t i = 0; i < chunk.store.size(); i++) {
+            writer.add(chunk.store, i);
+        }
+    }
+    return writer.flush() ? 0 : 1;
 }
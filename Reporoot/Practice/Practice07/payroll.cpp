@@ -0,0 +1,306 @@
+#include "payroll.h"
+#include "employee.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+
+int EmployeeView::getId() const {
+    if (type == SALARIED) return store->salaried.ids[row];
+    if (type == HOURLY) return store->hourly.ids[row];
+    return store->commission.ids[row];
+}
+
+std::string_view EmployeeView::getName() const {
+    if (type == SALARIED) return store->name(store->salaried.names[row]);
+    if (type == HOURLY) return store->name(store->hourly.names[row]);
+    return store->name(store->commission.names[row]);
+}
+
+double EmployeeView::calculateSalary() const {
+    if (type == SALARIED) return store->salaried.monthlySalary[row];
+    if (type == HOURLY) return store->hourly.hourlyRate[row] * store->hourly.hoursWorked[row];
+    const CommissionColumns& c = store->commission;
+    return c.baseSalary[row] + (c.totalSales[row] * c.commissionRate[row]);
+}
+
+// Same stream operations as the Employee classes, so output matches them
+// byte for byte, including where std::fixed takes effect
+void EmployeeView::displayInfo() const {
+    std::cout << "ID: " << getId() << ", Name: " << getName();
+    if (type == SALARIED) {
+        std::cout << ", Type: Salaried, Monthly Salary: $"
+            << std::fixed << std::setprecision(2) << calculateSalary() << "\n";
+    }
+    else if (type == HOURLY) {
+        std::cout << ", Type: Hourly, Hours Worked: " << store->hourly.hoursWorked[row]
+            << ", Hourly Rate: $" << std::fixed << std::setprecision(2) << store->hourly.hourlyRate[row]
+            << ", Salary: $" << calculateSalary() << "\n";
+    }
+    else {
+        const CommissionColumns& c = store->commission;
+        std::cout << ", Type: Commission, Base: $" << c.baseSalary[row]
+            << ", Sales: $" << c.totalSales[row]
+            << ", Rate: " << c.commissionRate[row]
+            << ", Salary: $" << std::fixed << std::setprecision(2) << calculateSalary() << "\n";
+    }
+}
+
+void RunningSum::add(double x) {
+    double t = sum + x;
+    if (std::fabs(sum) >= std::fabs(x)) compensation += (sum - t) + x;
+    else compensation += (x - t) + sum;
+    sum = t;
+}
+
+void PayrollStore::reserve(size_t count) {
+    order.reserve(count);
+}
+
+void PayrollStore::reserveGrowth(size_t extra) {
+    order.reserve(order.size() + extra);
+    salaried.ids.reserve(salaried.ids.size() + extra);
+    salaried.names.reserve(salaried.names.size() + extra);
+    salaried.monthlySalary.reserve(salaried.monthlySalary.size() + extra);
+    hourly.ids.reserve(hourly.ids.size() + extra);
+    hourly.names.reserve(hourly.names.size() + extra);
+    hourly.hourlyRate.reserve(hourly.hourlyRate.size() + extra);
+    hourly.hoursWorked.reserve(hourly.hoursWorked.size() + extra);
+    commission.ids.reserve(commission.ids.size() + extra);
+    commission.names.reserve(commission.names.size() + extra);
+    commission.baseSalary.reserve(commission.baseSalary.size() + extra);
+    commission.totalSales.reserve(commission.totalSales.size() + extra);
+    commission.commissionRate.reserve(commission.commissionRate.size() + extra);
+    nameTable.reserve(nameTable.size() + extra * 16);
+}
+
+NameRef PayrollStore::storeName(std::string_view name) {
+    NameRef ref = { (uint32_t)nameTable.size(), (uint32_t)name.size() };
+    nameTable.append(name.data(), name.size());
+    return ref;
+}
+
+// Append record to its type's columns and return the new row
+uint32_t PayrollStore::appendRow(const EmployeeRecord& record) {
+    NameRef name = storeName(record.name);
+    switch (record.type) {
+    case SALARIED:
+        salaried.ids.push_back(record.id);
+        salaried.names.push_back(name);
+        salaried.monthlySalary.push_back(record.amount);
+        return salaried.ids.size() - 1;
+    case HOURLY:
+        hourly.ids.push_back(record.id);
+        hourly.names.push_back(name);
+        hourly.hourlyRate.push_back(record.amount);
+        hourly.hoursWorked.push_back(record.hours);
+        return hourly.ids.size() - 1;
+    default:
+        commission.ids.push_back(record.id);
+        commission.names.push_back(name);
+        commission.baseSalary.push_back(record.amount);
+        commission.totalSales.push_back(record.sales);
+        commission.commissionRate.push_back(record.rate);
+        return commission.ids.size() - 1;
+    }
+}
+
+// Zero a row's pay so the column loops can keep running over it
+void PayrollStore::clearRow(RosterSlot slot) {
+    if (slot.type == SALARIED) {
+        salaried.monthlySalary[slot.row] = 0.0;
+    }
+    else if (slot.type == HOURLY) {
+        hourly.hourlyRate[slot.row] = 0.0;
+        hourly.hoursWorked[slot.row] = 0;
+    }
+    else if (slot.type == COMMISSION) {
+        commission.baseSalary[slot.row] = 0.0;
+        commission.totalSales[slot.row] = 0.0;
+        commission.commissionRate[slot.row] = 0.0;
+    }
+}
+
+size_t PayrollStore::add(const EmployeeRecord& record) {
+    uint32_t row = appendRow(record);
+    order.push_back({ record.type, row });
+    return order.size() - 1;
+}
+
+void PayrollStore::replace(size_t position, const EmployeeRecord& record) {
+    RosterSlot& slot = order[position];
+    if (slot.type != record.type) {
+        clearRow(slot);
+        slot = { record.type, appendRow(record) };
+        return;
+    }
+
+    // Same type: overwrite in place, and only grow the name table for a new name
+    uint32_t row = slot.row;
+    Column<NameRef>& names = record.type == SALARIED ? salaried.names
+        : (record.type == HOURLY ? hourly.names : commission.names);
+    if (name(names[row]) != record.name) names[row] = storeName(record.name);
+
+    if (record.type == SALARIED) {
+        salaried.ids[row] = record.id;
+        salaried.monthlySalary[row] = record.amount;
+    }
+    else if (record.type == HOURLY) {
+        hourly.ids[row] = record.id;
+        hourly.hourlyRate[row] = record.amount;
+        hourly.hoursWorked[row] = record.hours;
+    }
+    else {
+        commission.ids[row] = record.id;
+        commission.baseSalary[row] = record.amount;
+        commission.totalSales[row] = record.sales;
+        commission.commissionRate[row] = record.rate;
+    }
+}
+
+void PayrollStore::remove(size_t position) {
+    clearRow(order[position]);
+    order[position].type = REMOVED_SLOT;
+}
+
+bool PayrollStore::inSnapshot() const {
+    return mapping && order.attached() && nameTable.attached()
+        && salaried.ids.attached() && salaried.names.attached() && salaried.monthlySalary.attached()
+        && hourly.ids.attached() && hourly.names.attached() && hourly.hourlyRate.attached()
+        && hourly.hoursWorked.attached()
+        && commission.ids.attached() && commission.names.attached() && commission.baseSalary.attached()
+        && commission.totalSales.attached() && commission.commissionRate.attached();
+}
+
+void PayrollStore::computeSalaries(SalaryColumns& out) const {
+    size_t ns = salaried.monthlySalary.size();
+    size_t nh = hourly.hourlyRate.size();
+    size_t nc = commission.baseSalary.size();
+    out.salaried.resize(ns);
+    out.hourly.resize(nh);
+    out.commission.resize(nc);
+
+    const double* salary = salaried.monthlySalary.data();
+    double* __restrict s = out.salaried.data();
+    for (size_t i = 0; i < ns; i++) s[i] = salary[i];
+
+    const double* rate = hourly.hourlyRate.data();
+    const int* hours = hourly.hoursWorked.data();
+    double* __restrict h = out.hourly.data();
+    for (size_t i = 0; i < nh; i++) h[i] = rate[i] * hours[i];
+
+    const double* base = commission.baseSalary.data();
+    const double* sales = commission.totalSales.data();
+    const double* crate = commission.commissionRate.data();
+    double* __restrict c = out.commission.data();
+    for (size_t i = 0; i < nc; i++) c[i] = base[i] + (sales[i] * crate[i]);
+}
+
+namespace {
+
+// Four independent partial sums so the adds pipeline and map onto vector
+// lanes without -ffast-math. The order is fixed, so the result is repeatable.
+template <typename Term>
+double sumColumn(size_t n, Term term) {
+    double a0 = 0.0, a1 = 0.0, a2 = 0.0, a3 = 0.0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        a0 += term(i);
+        a1 += term(i + 1);
+        a2 += term(i + 2);
+        a3 += term(i + 3);
+    }
+    for (; i < n; i++) a0 += term(i);
+    return (a0 + a1) + (a2 + a3);
+}
+
+}
+
+PayrollTotals PayrollStore::totals() const {
+    PayrollTotals t;
+    const double* salary = salaried.monthlySalary.data();
+    t.salaried = sumColumn(salaried.monthlySalary.size(), [salary](size_t i) { return salary[i]; });
+
+    const double* rate = hourly.hourlyRate.data();
+    const int* hours = hourly.hoursWorked.data();
+    t.hourly = sumColumn(hourly.hourlyRate.size(), [rate, hours](size_t i) { return rate[i] * hours[i]; });
+
+    const double* base = commission.baseSalary.data();
+    const double* sales = commission.totalSales.data();
+    const double* crate = commission.commissionRate.data();
+    t.commission = sumColumn(commission.baseSalary.size(),
+        [base, sales, crate](size_t i) { return base[i] + (sales[i] * crate[i]); });
+    return t;
+}
+
+void benchmarkPayroll(size_t count) {
+    std::mt19937 rng(7);
+    std::vector<std::string> names(count);
+    std::vector<EmployeeRecord> records(count);
+    for (size_t i = 0; i < count; i++) {
+        names[i] = "Emp" + std::to_string(i);
+        EmployeeRecord& r = records[i];
+        r.id = 100000 + (int)i;
+        r.name = names[i];
+        switch (rng() % 3) {
+        case 0: r.type = SALARIED; r.amount = 3000 + rng() % 5000; break;
+        case 1: r.type = HOURLY; r.amount = 15.5 + rng() % 40; r.hours = 80 + rng() % 100; break;
+        default: r.type = COMMISSION; r.amount = 1000 + rng() % 2000; r.sales = rng() % 50000;
+            r.rate = (1 + rng() % 9) / 100.0;
+        }
+    }
+
+    auto seconds = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    // total < 0 for steps that do not produce a payroll total
+    auto report = [&](const char* name, double secs, double total) {
+        std::cout << std::setw(18) << std::left << name << std::right << std::fixed << std::setprecision(3)
+            << secs << " s  " << std::setprecision(1) << count / secs / 1e6 << "M employees/s";
+        if (total >= 0) std::cout << "  total $" << std::setprecision(2) << total;
+        std::cout << "\n";
+    };
+
+    std::cout << "payroll over " << count << " employees\n";
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Employee*> employees;
+    employees.reserve(count);
+    for (const auto& r : records) {
+        std::string name(r.name);
+        if (r.type == SALARIED) employees.push_back(new SalariedEmployee(name, r.id, r.amount));
+        else if (r.type == HOURLY) employees.push_back(new HourlyEmployee(name, r.id, r.amount, r.hours));
+        else employees.push_back(new CommissionEmployee(name, r.id, r.amount, r.sales, r.rate));
+    }
+    report("build Employee*", seconds(start), -1.0);
+
+    start = std::chrono::steady_clock::now();
+    double virtualTotal = 0.0;
+    for (const auto& emp : employees) virtualTotal += emp->calculateSalary();
+    report("virtual payroll", seconds(start), virtualTotal);
+
+    start = std::chrono::steady_clock::now();
+    PayrollStore store;
+    store.reserve(count);
+    for (const auto& r : records) store.add(r);
+    report("build store", seconds(start), -1.0);
+
+    start = std::chrono::steady_clock::now();
+    PayrollTotals totals = store.totals();
+    report("column payroll", seconds(start), totals.total());
+
+    SalaryColumns salaries;
+    store.computeSalaries(salaries);
+    start = std::chrono::steady_clock::now();
+    store.computeSalaries(salaries);
+    report("column salaries", seconds(start), -1.0);
+
+    start = std::chrono::steady_clock::now();
+    double viewTotal = 0.0;
+    for (size_t i = 0; i < store.size(); i++) viewTotal += store.at(i).calculateSalary();
+    report("view payroll", seconds(start), viewTotal);
+
+    for (auto emp : employees) delete emp;
+}
@@ -0,0 +1,259 @@
+#ifndef PAYROLL_H
+#define PAYROLL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "idindex.h"
+#include "loader.h"
+
+// Values the store either owns or reads in place from a mapped snapshot.
+// Values can be changed in place either way. Appends to a mapped column go
+// into the room the snapshot left after it; past that the column is copied
+// out of the mapping first.
+template <typename T>
+class Column {
+private:
+    std::vector<T> values;
+    T* base = nullptr;
+    size_t count = 0;
+    size_t room = 0;  // values the attached memory has space for
+
+    void own() {
+        if (base != values.data()) {
+            values.assign(base, base + count);
+            base = values.data();
+        }
+    }
+
+public:
+    Column() = default;
+    Column(const Column&) = delete;
+    Column& operator=(const Column&) = delete;
+    Column(Column&&) = default;
+    Column& operator=(Column&&) = default;
+
+    void reserve(size_t n) {
+        if (attached() && n <= room) return;
+        own();
+        values.reserve(n);
+        base = values.data();
+    }
+    void push_back(const T& value) {
+        if (attached() && count < room) {
+            base[count++] = value;
+            return;
+        }
+        own();
+        values.push_back(value);
+        base = values.data();
+        count = values.size();
+    }
+    void append(const T* data, size_t n) {
+        if (attached() && n <= room - count) {
+            std::copy(data, data + n, base + count);
+            count += n;
+            return;
+        }
+        own();
+        values.insert(values.end(), data, data + n);
+        base = values.data();
+        count = values.size();
+    }
+    // Use memory owned by someone else, such as a private mapping, with
+    // space for capacity values
+    void attach(T* data, size_t n, size_t capacity) {
+        std::vector<T>().swap(values);
+        base = data;
+        count = n;
+        room = capacity;
+    }
+    void attach(T* data, size_t n) { attach(data, n, n); }
+    bool attached() const { return base != values.data(); }
+
+    const T* data() const { return base; }
+    size_t size() const { return count; }
+    const T& operator[](size_t i) const { return base[i]; }
+    T& operator[](size_t i) { return base[i]; }
+};
+
+// A name in the store's name table
+struct NameRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+// One contiguous set of columns per employee type
+struct SalariedColumns {
+    Column<int> ids;
+    Column<NameRef> names;
+    Column<double> monthlySalary;
+};
+
+struct HourlyColumns {
+    Column<int> ids;
+    Column<NameRef> names;
+    Column<double> hourlyRate;
+    Column<int> hoursWorked;
+};
+
+struct CommissionColumns {
+    Column<int> ids;
+    Column<NameRef> names;
+    Column<double> baseSalary;
+    Column<double> totalSales;
+    Column<double> commissionRate;
+};
+
+struct PayrollTotals {
+    double salaried = 0.0;
+    double hourly = 0.0;
+    double commission = 0.0;
+    double total() const { return salaried + hourly + commission; }
+};
+
+// Salary of every employee, one column per type in the same order as the store
+struct SalaryColumns {
+    std::vector<double> salaried;
+    std::vector<double> hourly;
+    std::vector<double> commission;
+};
+
+// Where an employee sits in the store, kept in file order
+struct RosterSlot {
+    uint32_t type;  // EmployeeType, or REMOVED_SLOT
+    uint32_t row;
+};
+
+// Slot type of a removed employee. Its old row stays behind with zero pay.
+const uint32_t REMOVED_SLOT = 3;
+
+// Identity of the roster text a snapshot was built from
+struct RosterStamp {
+    uint64_t size;
+    int64_t mtimeNs;
+    uint32_t sampleCrc;  // CRC of the first and last 64 KiB
+};
+
+// Stamp file as it is on disk now
+bool stampRoster(const std::string& file, RosterStamp& stamp);
+
+// Compensated running sum, so long runs of += and -= do not drift
+struct RunningSum {
+    double sum = 0.0;
+    double compensation = 0.0;
+    void add(double x);
+    double value() const { return sum + compensation; }
+};
+
+// What a PayrollEngine keeps beside the store: the id index and running
+// totals. A snapshot can carry them, so an engine over a loaded snapshot
+// starts without a pass over the roster. Loaded this way the index lives in
+// the store's mapping and must not outlast the store.
+struct EngineState {
+    IdIndex index;
+    RunningSum running[3];    // indexed by EmployeeType
+    bool ready = false;       // built, or loaded with the snapshot
+    uint64_t generation = 0;  // of the snapshot it was saved in or loaded from
+};
+
+// Employees of any type a snapshot of count employees has room to add
+// before its columns are copied out of the mapping
+size_t snapshotHeadroom(size_t count);
+
+class PayrollStore;
+
+// Stand-in for an Employee* over one row of the store: same calls, no
+// allocation and no virtual dispatch
+class EmployeeView {
+private:
+    const PayrollStore* store;
+    EmployeeType type;
+    uint32_t row;
+
+public:
+    EmployeeView(const PayrollStore* store, EmployeeType type, uint32_t row)
+        : store(store), type(type), row(row) {}
+
+    EmployeeType getType() const { return type; }
+    int getId() const;
+    std::string_view getName() const;
+    double calculateSalary() const;
+    void displayInfo() const;
+};
+
+// Struct-of-arrays employee store, so payroll runs as three flat loops the
+// compiler can vectorize instead of a virtual call per employee
+class PayrollStore {
+public:
+    SalariedColumns salaried;
+    HourlyColumns hourly;
+    CommissionColumns commission;
+    Column<char> nameTable;  // every name, back to back
+
+    void reserve(size_t count);
+    // Room for extra more employees of any type without reallocating a column
+    void reserveGrowth(size_t extra);
+    // Append an employee and return its position in file order
+    size_t add(const EmployeeRecord& record);
+    // Overwrite the employee at position, keeping its place in file order
+    void replace(size_t position, const EmployeeRecord& record);
+    void remove(size_t position);
+
+    // Positions, including removed ones
+    size_t size() const { return order.size(); }
+    bool live(size_t position) const { return order[position].type != REMOVED_SLOT; }
+    std::string_view name(NameRef ref) const { return std::string_view(nameTable.data() + ref.offset, ref.length); }
+
+    // The employee at position i in file order
+    EmployeeView at(size_t i) const {
+        return EmployeeView(this, (EmployeeType)order[i].type, order[i].row);
+    }
+    const Column<RosterSlot>& fileOrder() const { return order; }
+
+    void computeSalaries(SalaryColumns& out) const;
+    PayrollTotals totals() const;
+
+    // True while every column still reads in place from a loaded snapshot
+    bool inSnapshot() const;
+
+    // Write the stores, in order, as one snapshot of the roster stamped with
+    // stamp, with room to grow by snapshotHeadroom. The engine state of a
+    // single store can go with it. The file is replaced atomically.
+    static bool saveSnapshot(const std::string& file, const RosterStamp& stamp,
+        const PayrollStore* const* stores, size_t count, const EngineState* state = nullptr);
+
+    // Map a snapshot as this store's columns, with no per-record decoding,
+    // and the engine state it carries into state if one is given. Fails,
+    // leaving the store as it was, if the file is missing, damaged, another
+    // version, or was built from a roster other than the one described by
+    // stamp. Rows, names, pay figures and the index are bounds-checked.
+    bool loadSnapshot(const std::string& file, const RosterStamp& stamp, EngineState* state = nullptr);
+
+    // Generation of the engine state saved in a snapshot, whatever roster it
+    // was built from; 0 if it has none or the header can't be read
+    static uint64_t snapshotGeneration(const std::string& file);
+
+private:
+    Column<RosterSlot> order;
+
+    uint32_t appendRow(const EmployeeRecord& record);
+    NameRef storeName(std::string_view name);
+    void clearRow(RosterSlot slot);
+
+    std::shared_ptr<void> mapping;  // set while columns point into a snapshot
+};
+
+// Build count synthetic employees both ways and time total payroll through
+// Employee* virtual calls against the store's column loops
+void benchmarkPayroll(size_t count);
+
+// Write a synthetic roster of count lines and time a text load against a
+// snapshot reload
+void benchmarkSnapshot(size_t count);
+
+#endif
@@ -0,0 +1,109 @@
+#include "pipeline.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+// Cut text into slices of about chunkBytes, each ending just after a newline
+void splitRoster(std::string_view text, size_t chunkBytes, std::vector<RosterChunk>& chunks) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end) {
+        const char* cut = end;
+        if ((size_t)(end - p) > chunkBytes) {
+            const char* eol = static_cast<const char*>(memchr(p + chunkBytes, '\n', end - p - chunkBytes));
+            if (eol) cut = eol + 1;
+        }
+        chunks.emplace_back();
+        chunks.back().text = std::string_view(p, cut - p);
+        p = cut;
+    }
+}
+
+void processChunk(RosterChunk& chunk, std::vector<EmployeeRecord>& records, size_t& lines) {
+    records.clear();
+    lines = parseRoster(chunk.text, records, chunk.errors);
+    chunk.store.reserve(records.size());
+    for (const auto& r : records) chunk.store.add(r);
+    chunk.totals = chunk.store.totals();
+}
+
+}
+
+void runPayroll(std::string_view text, unsigned threads, std::vector<RosterChunk>& chunks,
+    PayrollSummary& summary, size_t chunkBytes) {
+    chunks.clear();
+    splitRoster(text, chunkBytes, chunks);
+    std::vector<size_t> lines(chunks.size());
+
+    // Workers take the next unclaimed chunk, so a slow chunk does not hold up
+    // a whole thread's share
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        std::vector<EmployeeRecord> records;
+        for (size_t i = next++; i < chunks.size(); i = next++) processChunk(chunks[i], records, lines[i]);
+    };
+
+    size_t count = std::min<size_t>(std::max(threads, 1u), chunks.size());
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < count; t++) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+
+    // Merge strictly in chunk order
+    summary = PayrollSummary();
+    size_t firstLine = 1;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        RosterChunk& chunk = chunks[i];
+        for (auto& err : chunk.errors) err.line += firstLine - 1;
+        firstLine += lines[i];
+
+        summary.employees[SALARIED] += chunk.store.salaried.ids.size();
+        summary.employees[HOURLY] += chunk.store.hourly.ids.size();
+        summary.employees[COMMISSION] += chunk.store.commission.ids.size();
+        summary.totals.salaried += chunk.totals.salaried;
+        summary.totals.hourly += chunk.totals.hourly;
+        summary.totals.commission += chunk.totals.commission;
+    }
+}
+
+void benchmarkPipeline(size_t count, unsigned maxThreads) {
+    const char* file = "bench_pipeline.txt";
+    writeSyntheticRoster(file, count);
+
+    MappedFile mapped;
+    if (!mapped.open(file)) {
+        std::cerr << "Error: Cannot open file '" << file << "'\n";
+        return;
+    }
+
+    std::cout << "pipeline over " << count << " employees, " << std::thread::hardware_concurrency()
+        << " hardware threads\n";
+    PayrollSummary first;
+    double baseline = 0.0;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        std::vector<RosterChunk> chunks;
+        PayrollSummary summary;
+        auto start = std::chrono::steady_clock::now();
+        runPayroll(mapped.text(), threads, chunks, summary);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (threads == 1) {
+            first = summary;
+            baseline = seconds;
+        }
+        bool same = memcmp(&first.totals, &summary.totals, sizeof(PayrollTotals)) == 0
+            && std::equal(first.employees, first.employees + 3, summary.employees);
+        std::cout << std::setw(3) << threads << " threads  " << std::fixed << std::setprecision(3) << seconds
+            << " s  " << std::setprecision(1) << count / seconds / 1e6 << "M employees/s  speedup "
+            << std::setprecision(2) << baseline / seconds << "x  total $" << summary.totals.total()
+            << (same ? "" : "  MISMATCH") << "\n";
+    }
+    unlink(file);
+}
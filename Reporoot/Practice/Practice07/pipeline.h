@@ -0,0 +1,37 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+#include "loader.h"
+#include "payroll.h"
+
+// Chunks are cut at the first newline after every CHUNK_BYTES, independent
+// of the thread count, so the per-chunk sums and their merge never change
+const size_t CHUNK_BYTES = 1 << 20;
+
+// One slice of the roster, parsed and totalled by a single worker
+struct RosterChunk {
+    std::string_view text;
+    PayrollStore store;
+    std::vector<LoadError> errors;  // line numbers are file-wide
+    PayrollTotals totals;
+};
+
+struct PayrollSummary {
+    size_t employees[3] = {};  // indexed by EmployeeType
+    PayrollTotals totals;
+};
+
+// Parse and total the roster on up to threads workers. Chunks stay in file
+// order and are merged in that order, so summary is bit-identical for any
+// thread count. Each chunk's text is a view into text.
+void runPayroll(std::string_view text, unsigned threads, std::vector<RosterChunk>& chunks,
+    PayrollSummary& summary, size_t chunkBytes = CHUNK_BYTES);
+
+// Write a synthetic roster of count lines and time runPayroll from one
+// thread up to maxThreads, checking every run gives the same totals
+void benchmarkPipeline(size_t count, unsigned maxThreads);
+
+#endif
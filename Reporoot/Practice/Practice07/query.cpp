@@ -0,0 +1,235 @@
+#include "query.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <utility>
+
+namespace {
+
+// First eight bytes of a name as a big-endian number, zero padded, so
+// comparing keys orders names the same way as comparing the text
+uint64_t nameKey(std::string_view name) {
+    unsigned char bytes[8] = {};
+    memcpy(bytes, name.data(), std::min<size_t>(name.size(), 8));
+    uint64_t key = 0;
+    for (unsigned char b : bytes) key = (key << 8) | b;
+    return key;
+}
+
+// Names are sorted on their first sixteen bytes, taken during one pass in
+// file order; the text is only looked at again to break ties between
+// longer names
+struct NameEntry {
+    uint64_t high;
+    uint64_t low;
+    uint32_t position;
+    uint32_t length;
+
+    bool sameKey(const NameEntry& other) const { return high == other.high && low == other.low; }
+};
+
+}
+
+PayrollIndex::PayrollIndex(const PayrollStore& store) : store(store) {
+    SalaryColumns salaries;
+    store.computeSalaries(salaries);
+    const std::vector<double>* columns[3] = { &salaries.salaried, &salaries.hourly, &salaries.commission };
+
+    byPay[SALARIED].reserve(salaries.salaried.size());
+    byPay[HOURLY].reserve(salaries.hourly.size());
+    byPay[COMMISSION].reserve(salaries.commission.size());
+    ids.reserve(store.size());
+    std::vector<NameEntry> names;
+    names.reserve(store.size());
+    for (size_t i = 0; i < store.size(); i++) {
+        RosterSlot slot = store.fileOrder()[i];
+        if (slot.type == REMOVED_SLOT) continue;
+        EmployeeView e = store.at(i);
+        ids.insert(e.getId(), i);
+        byPay[slot.type].push_back({ (*columns[slot.type])[slot.row], (uint32_t)i });
+        std::string_view name = e.getName();
+        names.push_back({ nameKey(name), nameKey(name.substr(std::min<size_t>(name.size(), 8))), (uint32_t)i,
+            (uint32_t)name.size() });
+    }
+
+    // Lowest pay first; among equal pay the later employee first, so reading
+    // from the back gives file order
+    for (auto& entries : byPay) {
+        std::sort(entries.begin(), entries.end(), [](const PayEntry& a, const PayEntry& b) {
+            if (a.salary != b.salary) return a.salary < b.salary;
+            return a.position > b.position;
+        });
+    }
+
+    std::sort(names.begin(), names.end(), [](const NameEntry& a, const NameEntry& b) {
+        if (a.high != b.high) return a.high < b.high;
+        if (a.low != b.low) return a.low < b.low;
+        return a.position < b.position;
+    });
+    byName.resize(names.size());
+    std::vector<std::pair<std::string_view, uint32_t>> run;
+    for (size_t start = 0; start < names.size();) {
+        size_t end = start + 1;
+        bool longer = names[start].length > 16;
+        while (end < names.size() && names[end].sameKey(names[start])) longer |= names[end++].length > 16;
+        if (!longer) {
+            for (size_t i = start; i < end; i++) byName[i] = names[i].position;
+        }
+        else {
+            run.clear();
+            for (size_t i = start; i < end; i++) run.push_back({ store.at(names[i].position).getName(), names[i].position });
+            std::sort(run.begin(), run.end());
+            for (size_t i = start; i < end; i++) byName[i] = run[i - start].second;
+        }
+        start = end;
+    }
+}
+
+bool PayrollIndex::findId(int id, size_t& position) const {
+    uint32_t p;
+    if (!ids.find(id, p)) return false;
+    position = p;
+    return true;
+}
+
+bool PayrollIndex::percentile(EmployeeType type, double p, double& salary) const {
+    const std::vector<PayEntry>& entries = byPay[type];
+    if (entries.empty() || !(p >= 0.0 && p <= 100.0)) return false;
+    size_t rank = (size_t)std::ceil(p / 100.0 * entries.size());
+    salary = entries[rank > 0 ? rank - 1 : 0].salary;
+    return true;
+}
+
+void PayrollIndex::topEarners(EmployeeType type, size_t n, std::vector<PayEntry>& out) const {
+    const std::vector<PayEntry>& entries = byPay[type];
+    n = std::min(n, entries.size());
+    out.assign(entries.rbegin(), entries.rbegin() + n);
+}
+
+// Merge the top of the three per-type columns
+void PayrollIndex::topEarners(size_t n, std::vector<PayEntry>& out) const {
+    out.clear();
+    size_t next[3] = { byPay[0].size(), byPay[1].size(), byPay[2].size() };
+    while (out.size() < n) {
+        int best = -1;
+        for (int t = 0; t < 3; t++) {
+            if (next[t] == 0) continue;
+            const PayEntry& e = byPay[t][next[t] - 1];
+            if (best < 0) {
+                best = t;
+                continue;
+            }
+            const PayEntry& b = byPay[best][next[best] - 1];
+            if (e.salary > b.salary || (e.salary == b.salary && e.position < b.position)) best = t;
+        }
+        if (best < 0) break;
+        out.push_back(byPay[best][--next[best]]);
+    }
+}
+
+void PayrollIndex::namePrefix(std::string_view prefix, std::vector<uint32_t>& out, size_t limit) const {
+    out.clear();
+    auto first = std::lower_bound(byName.begin(), byName.end(), prefix, [&](uint32_t position, std::string_view text) {
+        return store.at(position).getName() < text;
+    });
+    for (auto it = first; it != byName.end() && out.size() < limit; ++it) {
+        if (store.at(*it).getName().substr(0, prefix.size()) != prefix) break;
+        out.push_back(*it);
+    }
+}
+
+void benchmarkQueries(size_t count) {
+    PayrollStore store;
+    {
+        std::mt19937 rng(17);
+        std::vector<std::string> names(count);
+        store.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            names[i] = "Emp" + std::to_string(rng() % (count * 4));
+            EmployeeRecord r = {};
+            r.id = 100000 + (int)i;
+            r.name = names[i];
+            switch (rng() % 3) {
+            case 0: r.type = SALARIED; r.amount = 3000 + rng() % 5000 + 0.25; break;
+            case 1: r.type = HOURLY; r.amount = 15.5 + rng() % 40; r.hours = 80 + rng() % 100; break;
+            default: r.type = COMMISSION; r.amount = 1000 + rng() % 2000; r.sales = rng() % 50000 + 0.5;
+                r.rate = (1 + rng() % 9) / 100.0;
+            }
+            store.add(r);
+        }
+    }
+
+    auto seconds = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    auto report = [](const char* name, double secs, size_t queries, size_t results) {
+        std::cout << std::setw(18) << std::left << name << std::right << std::fixed << std::setprecision(3)
+            << secs * 1e9 / queries / 1000 << " us/query  (" << queries << " queries, " << results << " results)\n";
+    };
+
+    std::cout << "queries over " << count << " employees\n";
+
+    auto start = std::chrono::steady_clock::now();
+    PayrollIndex index(store);
+    std::cout << "index build       " << std::fixed << std::setprecision(3) << seconds(start) << " s (once)\n";
+
+    // Linear scans answer the same questions without an index, for scale
+    start = std::chrono::steady_clock::now();
+    SalaryColumns salaries;
+    store.computeSalaries(salaries);
+    std::vector<double> top(salaries.salaried);
+    std::nth_element(top.begin(), top.begin() + top.size() / 2, top.end());
+    double scan = seconds(start);
+    report("scan median", scan, 1, 1);
+
+    std::mt19937 rng(23);
+    size_t queries = 1000000, found = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < queries; i++) {
+        size_t position;
+        found += index.findId(100000 + (int)(rng() % (count + count / 10)), position);
+    }
+    report("id lookup", seconds(start), queries, found);
+
+    queries = 100000;
+    found = 0;
+    double checksum = 0.0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < queries; i++) {
+        double salary;
+        if (index.percentile((EmployeeType)(i % 3), (rng() % 10001) / 100.0, salary)) {
+            found++;
+            checksum += salary;
+        }
+    }
+    report("percentile", seconds(start), queries, found);
+
+    queries = 10000;
+    found = 0;
+    std::vector<PayEntry> earners;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < queries; i++) {
+        index.topEarners(100, earners);
+        found += earners.size();
+    }
+    report("top 100", seconds(start), queries, found);
+
+    found = 0;
+    std::vector<uint32_t> matches;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < queries; i++) {
+        std::string prefix = "Emp" + std::to_string(rng() % (count * 4));
+        prefix.resize(3 + 1 + rng() % (prefix.size() - 3));
+        index.namePrefix(prefix, matches, 100);
+        found += matches.size();
+    }
+    report("name prefix", seconds(start), queries, found);
+
+    // Keep the optimizer from dropping the percentile loop
+    if (checksum < 0) std::cout << checksum << "\n";
+}
@@ -0,0 +1,48 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "idindex.h"
+#include "payroll.h"
+
+struct PayEntry {
+    double salary;
+    uint32_t position;  // in the store's file order
+};
+
+// Read-only indexes over a PayrollStore for ad-hoc queries: a hash on id,
+// salaries sorted per type, and positions sorted by name. Building takes
+// O(n log n); rebuild after the store changes.
+class PayrollIndex {
+public:
+    explicit PayrollIndex(const PayrollStore& store);
+
+    bool findId(int id, size_t& position) const;
+
+    // Salary at percentile p (0 to 100, nearest rank) among one type.
+    // False if there are no employees of that type.
+    bool percentile(EmployeeType type, double p, double& salary) const;
+
+    // The n best paid employees, highest first, ties in file order
+    void topEarners(size_t n, std::vector<PayEntry>& out) const;
+    void topEarners(EmployeeType type, size_t n, std::vector<PayEntry>& out) const;
+
+    // Positions of up to limit employees whose name starts with prefix, in name order
+    void namePrefix(std::string_view prefix, std::vector<uint32_t>& out, size_t limit = SIZE_MAX) const;
+
+    size_t count(EmployeeType type) const { return byPay[type].size(); }
+
+private:
+    const PayrollStore& store;
+    IdIndex ids;
+    std::vector<PayEntry> byPay[3];  // per type, lowest salary first
+    std::vector<uint32_t> byName;
+};
+
+// Build the indexes over count synthetic employees and time each kind of query
+void benchmarkQueries(size_t count);
+
+#endif
@@ -0,0 +1,361 @@
+#include "report.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <iterator>
+#include <random>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+const char* const TYPE_NAMES[3] = { "Salaried", "Hourly", "Commission" };
+
+// Room for every fixed part of the longest line; the name is added on top
+const size_t MAX_LINE = 512;
+
+// Fields on a CSV line, with commas inside quoted names not counted
+size_t csvFields(const std::string& line) {
+    size_t fields = 1;
+    bool quoted = false;
+    for (char c : line) {
+        if (c == '"') quoted = !quoted;
+        else if (c == ',' && !quoted) fields++;
+    }
+    return fields;
+}
+
+// Whether every row of a CSV report has as many fields as its header and
+// there is one row per employee
+bool checkCsv(const char* file, size_t count) {
+    std::ifstream in(file);
+    std::string line;
+    if (!std::getline(in, line)) return false;
+    size_t columns = csvFields(line);
+    size_t rows = 0;
+    while (std::getline(in, line)) {
+        if (csvFields(line) != columns) return false;
+        rows++;
+    }
+    return rows == count;
+}
+
+// Whether a binary report is a header and then exactly count whole records
+bool checkBinary(const char* file, size_t count) {
+    std::ifstream in(file, std::ios::binary);
+    ReportHeader h;
+    if (!in.read((char*)&h, sizeof(h)) || memcmp(h.magic, "PAYR", 4) != 0 || h.version != 1) return false;
+    std::string name;
+    size_t records = 0;
+    ReportRecord r;
+    while (in.read((char*)&r, sizeof(r))) {
+        if (r.type > COMMISSION) return false;
+        name.resize(r.nameLength);
+        if (!in.read(&name[0], r.nameLength)) return false;
+        records++;
+    }
+    return in.gcount() == 0 && records == count;
+}
+
+}
+
+ReportWriter::ReportWriter(int fd, ReportFormat format, size_t bufferSize)
+    : fd(fd), format(format), buffer(bufferSize), used(0), fixedMoney(false), failed(false) {}
+
+bool ReportWriter::flush() {
+    const char* p = buffer.data();
+    while (!failed && used > 0) {
+        ssize_t n = write(fd, p, used);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            failed = true;
+        }
+        else {
+            p += n;
+            used -= n;
+        }
+    }
+    used = 0;
+    return !failed;
+}
+
+// At least n free bytes at the end of the buffer
+char* ReportWriter::reserve(size_t n) {
+    if (buffer.size() - used < n) {
+        flush();
+        if (buffer.size() < n) buffer.resize(n);
+    }
+    return buffer.data() + used;
+}
+
+void ReportWriter::put(std::string_view text) {
+    memcpy(reserve(text.size()), text.data(), text.size());
+    used += text.size();
+}
+
+void ReportWriter::putInt(long long value) {
+    char* p = reserve(24);
+    used = std::to_chars(p, p + 24, value).ptr - buffer.data();
+}
+
+// Same digits as std::fixed << std::setprecision(2). Amounts up to about
+// $10 billion whose cents are not near a rounding tie are scaled to whole
+// cents directly; anything else goes through std::to_chars.
+void ReportWriter::putFixed2(double value) {
+    char* p = reserve(350);
+    double cents = std::fabs(value) * 100.0;
+    if (cents < 1e12) {
+        // Below 2^40 the scaled value is within 2^-12 of the exact one, so a
+        // fraction clear of .5 by more than that rounds the same either way
+        double whole = std::floor(cents);
+        double fraction = cents - whole;
+        if (std::fabs(fraction - 0.5) > 1e-3) {
+            uint64_t n = (uint64_t)whole + (fraction > 0.5);
+            if (std::signbit(value)) *p++ = '-';
+            p = std::to_chars(p, p + 24, n / 100).ptr;
+            unsigned c = n % 100;
+            p[0] = '.';
+            p[1] = (char)('0' + c / 10);
+            p[2] = (char)('0' + c % 10);
+            used = p + 3 - buffer.data();
+            return;
+        }
+    }
+    used = std::to_chars(p, p + 350, value, std::chars_format::fixed, 2).ptr - buffer.data();
+}
+
+// Without std::fixed an ostream prints like %g at precision 6
+void ReportWriter::putStreamDouble(double value) {
+    if (fixedMoney) {
+        putFixed2(value);
+        return;
+    }
+    char* p = reserve(32);
+    used = std::to_chars(p, p + 32, value, std::chars_format::general, 6).ptr - buffer.data();
+}
+
+// Shortest text that reads back as the same double
+void ReportWriter::putShortest(double value) {
+    char* p = reserve(32);
+    used = std::to_chars(p, p + 32, value).ptr - buffer.data();
+}
+
+void ReportWriter::putCsvName(std::string_view name) {
+    if (name.find_first_of(",\"\r\n") == std::string_view::npos) {
+        put(name);
+        return;
+    }
+    put("\"");
+    for (size_t start = 0;;) {
+        size_t quote = name.find('"', start);
+        put(name.substr(start, quote - start));
+        if (quote == std::string_view::npos) break;
+        put("\"\"");
+        start = quote + 1;
+    }
+    put("\"");
+}
+
+void ReportWriter::begin() {
+    if (format == REPORT_TEXT) {
+        put("\nEmployee Info:\n");
+    }
+    else if (format == REPORT_CSV) {
+        put("id,name,type,monthly_salary,hourly_rate,hours_worked,base_salary,total_sales,commission_rate,salary\n");
+    }
+    else {
+        ReportHeader h = { { 'P', 'A', 'Y', 'R' }, 1 };
+        memcpy(reserve(sizeof(h)), &h, sizeof(h));
+        used += sizeof(h);
+    }
+}
+
+void ReportWriter::add(const PayrollStore& store, size_t position) {
+    RosterSlot slot = store.fileOrder()[position];
+    if (slot.type == REMOVED_SLOT) return;
+    uint32_t row = slot.row;
+
+    ReportRecord r = {};
+    std::string_view name;
+    r.type = slot.type;
+    if (slot.type == SALARIED) {
+        r.id = store.salaried.ids[row];
+        name = store.name(store.salaried.names[row]);
+        r.amount = store.salaried.monthlySalary[row];
+        r.salary = r.amount;
+    }
+    else if (slot.type == HOURLY) {
+        r.id = store.hourly.ids[row];
+        name = store.name(store.hourly.names[row]);
+        r.amount = store.hourly.hourlyRate[row];
+        r.hoursWorked = store.hourly.hoursWorked[row];
+        r.salary = r.amount * r.hoursWorked;
+    }
+    else {
+        r.id = store.commission.ids[row];
+        name = store.name(store.commission.names[row]);
+        r.amount = store.commission.baseSalary[row];
+        r.totalSales = store.commission.totalSales[row];
+        r.commissionRate = store.commission.commissionRate[row];
+        r.salary = r.amount + (r.totalSales * r.commissionRate);
+    }
+    reserve(MAX_LINE + name.size() * 2);
+
+    if (format == REPORT_BINARY) {
+        r.nameLength = name.size();
+        memcpy(buffer.data() + used, &r, sizeof(r));
+        used += sizeof(r);
+        put(name);
+        return;
+    }
+
+    if (format == REPORT_CSV) {
+        putInt(r.id);
+        put(",");
+        putCsvName(name);
+        put(",");
+        put(TYPE_NAMES[slot.type]);
+        if (slot.type == SALARIED) {
+            put(",");
+            putShortest(r.amount);
+            put(",,,,,,");
+        }
+        else if (slot.type == HOURLY) {
+            put(",,");
+            putShortest(r.amount);
+            put(",");
+            putInt(r.hoursWorked);
+            put(",,,,");
+        }
+        else {
+            put(",,,,");
+            putShortest(r.amount);
+            put(",");
+            putShortest(r.totalSales);
+            put(",");
+            putShortest(r.commissionRate);
+            put(",");
+        }
+        putFixed2(r.salary);
+        put("\n");
+        return;
+    }
+
+    put("ID: ");
+    putInt(r.id);
+    put(", Name: ");
+    put(name);
+    if (slot.type == SALARIED) {
+        put(", Type: Salaried, Monthly Salary: $");
+        putFixed2(r.salary);
+    }
+    else if (slot.type == HOURLY) {
+        put(", Type: Hourly, Hours Worked: ");
+        putInt(r.hoursWorked);
+        put(", Hourly Rate: $");
+        putFixed2(r.amount);
+        put(", Salary: $");
+        putFixed2(r.salary);
+    }
+    else {
+        put(", Type: Commission, Base: $");
+        putStreamDouble(r.amount);
+        put(", Sales: $");
+        putStreamDouble(r.totalSales);
+        put(", Rate: ");
+        putStreamDouble(r.commissionRate);
+        put(", Salary: $");
+        putFixed2(r.salary);
+    }
+    put("\n");
+    fixedMoney = true;  // every displayInfo() leaves std::cout in fixed mode
+}
+
+void benchmarkReport(size_t count) {
+    PayrollStore store;
+    {
+        std::mt19937 rng(13);
+        std::vector<std::string> names(count);
+        store.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            names[i] = "Emp" + std::to_string(i);
+            EmployeeRecord r = {};
+            r.id = 100000 + (int)i;
+            r.name = names[i];
+            switch (rng() % 3) {
+            case 0: r.type = SALARIED; r.amount = 3000 + rng() % 5000 + 0.25; break;
+            case 1: r.type = HOURLY; r.amount = 15.5 + rng() % 40; r.hours = 80 + rng() % 100; break;
+            default: r.type = COMMISSION; r.amount = 1000 + rng() % 2000; r.sales = rng() % 50000 + 0.5;
+                r.rate = (1 + rng() % 9) / 100.0;
+            }
+            store.add(r);
+        }
+    }
+
+    auto seconds = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    auto fileSize = [](const char* file) {
+        std::ifstream in(file, std::ios::binary | std::ios::ate);
+        return (size_t)in.tellg();
+    };
+    auto report = [&](const char* name, double secs, const char* file) {
+        std::cout << std::setw(18) << std::left << name << std::right << std::fixed << std::setprecision(3)
+            << secs << " s  " << std::setprecision(1) << count / secs / 1e6 << "M lines/s  "
+            << fileSize(file) / secs / (1 << 20) << " MiB/s\n";
+    };
+
+    std::cout << "report of " << count << " employees\n";
+
+    // displayInfo() writes to std::cout, so point it at a file for the run
+    const char* streamFile = "bench_report_stream.txt";
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::ofstream out(streamFile);
+        std::streambuf* saved = std::cout.rdbuf(out.rdbuf());
+        std::ios::fmtflags flags = std::cout.flags();
+        std::streamsize precision = std::cout.precision();
+        std::cout.unsetf(std::ios::floatfield);
+        std::cout.precision(6);
+        std::cout << "\nEmployee Info:\n";
+        for (size_t i = 0; i < store.size(); i++) store.at(i).displayInfo();
+        std::cout.flush();
+        std::cout.rdbuf(saved);
+        std::cout.flags(flags);
+        std::cout.precision(precision);
+    }
+    double streamSeconds = seconds(start);
+    report("displayInfo", streamSeconds, streamFile);
+
+    const char* files[3] = { "bench_report.txt", "bench_report.csv", "bench_report.bin" };
+    const char* labels[3] = { "writer text", "writer csv", "writer binary" };
+    for (int f = REPORT_TEXT; f <= REPORT_BINARY; f++) {
+        start = std::chrono::steady_clock::now();
+        int fd = open(files[f], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        {
+            ReportWriter writer(fd, (ReportFormat)f);
+            writer.begin();
+            for (size_t i = 0; i < store.size(); i++) writer.add(store, i);
+        }
+        close(fd);
+        report(labels[f], seconds(start), files[f]);
+    }
+
+    std::ifstream a(streamFile, std::ios::binary), b(files[REPORT_TEXT], std::ios::binary);
+    bool same = std::equal(std::istreambuf_iterator<char>(a), std::istreambuf_iterator<char>(),
+        std::istreambuf_iterator<char>(b), std::istreambuf_iterator<char>());
+    std::cout << "text output " << (same ? "identical" : "DIFFERENT") << " to displayInfo\n"
+        << "csv output " << (checkCsv(files[REPORT_CSV], store.size()) ? "well formed" : "MALFORMED") << "\n"
+        << "binary output " << (checkBinary(files[REPORT_BINARY], store.size()) ? "well formed" : "MALFORMED")
+        << "\n";
+
+    unlink(streamFile);
+    for (const char* file : files) unlink(file);
+}
@@ -0,0 +1,71 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+#include "payroll.h"
+
+enum ReportFormat {
+    REPORT_TEXT,    // the displayInfo() lines
+    REPORT_CSV,     // one row per employee with a header row
+    REPORT_BINARY   // fixed-width little-endian records, see ReportRecord
+};
+
+// Binary report layout: a ReportHeader, then for each employee a
+// ReportRecord followed by nameLength bytes of name
+struct ReportHeader {
+    char magic[4];     // "PAYR"
+    uint32_t version;
+};
+
+struct ReportRecord {
+    int32_t id;
+    uint32_t type;     // EmployeeType
+    int32_t hoursWorked;
+    uint32_t nameLength;
+    double amount;     // monthly salary, hourly rate or base salary
+    double totalSales;
+    double commissionRate;
+    double salary;
+};
+
+// Formats employees into a large reusable buffer with std::to_chars and
+// hands it to write(2) in big pieces. Text output matches displayInfo()
+// on a fresh std::cout byte for byte, including the Commission fields that
+// print unformatted until an earlier line has switched to two decimals.
+class ReportWriter {
+private:
+    int fd;
+    ReportFormat format;
+    std::vector<char> buffer;
+    size_t used;
+    bool fixedMoney;  // whether std::cout would be in fixed mode by now
+    bool failed;
+
+    char* reserve(size_t n);
+    void put(std::string_view text);
+    void putInt(long long value);
+    void putFixed2(double value);
+    void putStreamDouble(double value);  // as std::cout would print it now
+    void putShortest(double value);
+    void putCsvName(std::string_view name);
+
+public:
+    ReportWriter(int fd, ReportFormat format, size_t bufferSize = 1 << 20);
+    ~ReportWriter() { flush(); }
+    ReportWriter(const ReportWriter&) = delete;
+    ReportWriter& operator=(const ReportWriter&) = delete;
+
+    // The text heading, CSV header row or binary header
+    void begin();
+    void add(const PayrollStore& store, size_t position);
+    bool flush();
+    bool ok() const { return !failed; }
+};
+
+// Time displayInfo() against ReportWriter in each format for count
+// employees, and check the text outputs are identical
+void benchmarkReport(size_t count);
+
+#endif
@@ -0,0 +1,452 @@
+#include "payroll.h"
+#include "pipeline.h"
+#include "../common/crc32.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+const uint32_t SNAPSHOT_MAGIC = 0x53594150;  // "PAYS"
+const uint32_t SNAPSHOT_VERSION = 2;
+const size_t HEADER_SIZE = 256;
+const size_t SECTION_ALIGN = 64;             // every column starts on a cache line
+const size_t SAMPLE_BYTES = 64 << 10;
+const size_t NAME_ROOM = 16;                 // name table bytes left per employee of headroom
+
+// Sections in file order, one per column
+enum Section {
+    ORDER,
+    SALARIED_IDS, SALARIED_NAMES, SALARIED_SALARY,
+    HOURLY_IDS, HOURLY_NAMES, HOURLY_RATE, HOURLY_HOURS,
+    COMMISSION_IDS, COMMISSION_NAMES, COMMISSION_BASE, COMMISSION_SALES, COMMISSION_RATE,
+    ID_INDEX,
+    NAME_TABLE,
+    SECTION_COUNT
+};
+
+struct SnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    RosterStamp source;
+    uint64_t employees;
+    uint64_t counts[3];     // rows per EmployeeType
+    uint64_t nameBytes;
+    uint64_t headroom;      // employees every column has room to add
+    uint64_t generation;    // nonzero if the snapshot carries engine state
+    uint64_t indexSlots;
+    uint64_t indexCount;
+    double running[3][2];   // engine totals per EmployeeType: sum, compensation
+    uint32_t crc;           // over the fields above
+};
+
+static_assert(sizeof(SnapshotHeader) <= HEADER_SIZE, "snapshot header outgrew its space");
+
+uint32_t headerCrc(const SnapshotHeader& h) {
+    return crc32(reinterpret_cast<const unsigned char*>(&h), offsetof(SnapshotHeader, crc));
+}
+
+size_t alignUp(size_t n) {
+    return (n + SECTION_ALIGN - 1) & ~(SECTION_ALIGN - 1);
+}
+
+// Fill in where each section starts and return the file size. Every
+// column is followed by room for headroom more rows.
+size_t layout(const SnapshotHeader& h, size_t offsets[SECTION_COUNT]) {
+    uint64_t room = h.headroom;
+    uint64_t s = h.counts[SALARIED] + room, hr = h.counts[HOURLY] + room, c = h.counts[COMMISSION] + room;
+    const size_t bytes[SECTION_COUNT] = {
+        (h.employees + room) * sizeof(RosterSlot),
+        s * sizeof(int), s * sizeof(NameRef), s * sizeof(double),
+        hr * sizeof(int), hr * sizeof(NameRef), hr * sizeof(double), hr * sizeof(int),
+        c * sizeof(int), c * sizeof(NameRef), c * sizeof(double), c * sizeof(double), c * sizeof(double),
+        h.indexSlots * sizeof(IdIndex::Entry),
+        h.nameBytes + room * NAME_ROOM
+    };
+    size_t pos = HEADER_SIZE;
+    for (int k = 0; k < SECTION_COUNT; k++) {
+        offsets[k] = pos;
+        pos = alignUp(pos + bytes[k]);
+    }
+    return pos;
+}
+
+// The bytes a store contributes to a plain section
+const void* sectionData(const PayrollStore& store, int section, size_t& bytes) {
+    switch (section) {
+    case SALARIED_IDS: bytes = store.salaried.ids.size() * sizeof(int); return store.salaried.ids.data();
+    case SALARIED_SALARY: bytes = store.salaried.monthlySalary.size() * sizeof(double); return store.salaried.monthlySalary.data();
+    case HOURLY_IDS: bytes = store.hourly.ids.size() * sizeof(int); return store.hourly.ids.data();
+    case HOURLY_RATE: bytes = store.hourly.hourlyRate.size() * sizeof(double); return store.hourly.hourlyRate.data();
+    case HOURLY_HOURS: bytes = store.hourly.hoursWorked.size() * sizeof(int); return store.hourly.hoursWorked.data();
+    case COMMISSION_IDS: bytes = store.commission.ids.size() * sizeof(int); return store.commission.ids.data();
+    case COMMISSION_BASE: bytes = store.commission.baseSalary.size() * sizeof(double); return store.commission.baseSalary.data();
+    case COMMISSION_SALES: bytes = store.commission.totalSales.size() * sizeof(double); return store.commission.totalSales.data();
+    case COMMISSION_RATE: bytes = store.commission.commissionRate.size() * sizeof(double); return store.commission.commissionRate.data();
+    default: bytes = store.nameTable.size(); return store.nameTable.data();
+    }
+}
+
+const Column<NameRef>& nameColumn(const PayrollStore& store, int section) {
+    if (section == SALARIED_NAMES) return store.salaried.names;
+    if (section == HOURLY_NAMES) return store.hourly.names;
+    return store.commission.names;
+}
+
+// Checks on the mapped body, which the header CRC does not cover: every
+// row and name it refers to lies inside the file, and pay figures are finite
+bool slotsInside(const Column<RosterSlot>& order, const uint64_t counts[3]) {
+    for (size_t i = 0; i < order.size(); i++) {
+        RosterSlot slot = order[i];
+        if (slot.type > REMOVED_SLOT || (slot.type != REMOVED_SLOT && slot.row >= counts[slot.type])) return false;
+    }
+    return true;
+}
+
+bool namesInside(const Column<NameRef>& names, uint64_t nameBytes) {
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i].offset > nameBytes || names[i].length > nameBytes - names[i].offset) return false;
+    }
+    return true;
+}
+
+bool allFinite(const Column<double>& values) {
+    for (size_t i = 0; i < values.size(); i++) {
+        if (!std::isfinite(values[i])) return false;
+    }
+    return true;
+}
+
+// Every id in the index points at a live employee, and the table has the
+// free slots a probe needs to stop
+bool indexInside(const IdIndex::Entry* table, const SnapshotHeader& h, const Column<RosterSlot>& order) {
+    if (h.indexSlots < 16 || (h.indexSlots & (h.indexSlots - 1)) != 0 || h.indexCount * 10 > h.indexSlots * 7) {
+        return false;
+    }
+    size_t used = 0;
+    for (size_t i = 0; i < h.indexSlots; i++) {
+        if (table[i].id == IdIndex::EMPTY_ID) continue;
+        if (table[i].position >= order.size() || order[table[i].position].type == REMOVED_SLOT) return false;
+        used++;
+    }
+    for (int t = 0; t < 3; t++) {
+        if (!std::isfinite(h.running[t][0]) || !std::isfinite(h.running[t][1])) return false;
+    }
+    return used == h.indexCount;
+}
+
+// Buffered sequential writer that tracks the file position
+class SnapshotWriter {
+private:
+    int fd;
+    std::vector<char> buffer;
+    size_t used;
+    size_t position;
+    bool ok;
+
+    void flush() {
+        const char* p = buffer.data();
+        while (ok && used > 0) {
+            ssize_t n = write(fd, p, used);
+            if (n < 0) ok = false;
+            else {
+                p += n;
+                used -= n;
+            }
+        }
+        used = 0;
+    }
+
+public:
+    SnapshotWriter(int fd) : fd(fd), buffer(1 << 20), used(0), position(0), ok(true) {}
+
+    void put(const void* data, size_t len) {
+        position += len;
+        const char* p = static_cast<const char*>(data);
+        while (len > 0) {
+            if (used == buffer.size()) flush();
+            size_t n = std::min(len, buffer.size() - used);
+            memcpy(buffer.data() + used, p, n);
+            used += n;
+            p += n;
+            len -= n;
+        }
+    }
+
+    void padTo(size_t offset) {
+        static const char zeros[SECTION_ALIGN] = {};
+        while (position < offset) put(zeros, std::min(offset - position, SECTION_ALIGN));
+    }
+
+    bool finish() {
+        flush();
+        return ok && fsync(fd) == 0;
+    }
+};
+
+}
+
+bool stampRoster(const std::string& file, RosterStamp& stamp) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    // Sample the head and tail so an edit that keeps size and mtime is still caught there
+    size_t size = st.st_size;
+    size_t head = std::min(size, SAMPLE_BYTES);
+    size_t tail = std::min(size - head, SAMPLE_BYTES);
+    std::vector<unsigned char> sample(head + tail);
+    bool ok = pread(fd, sample.data(), head, 0) == (ssize_t)head
+        && pread(fd, sample.data() + head, tail, size - tail) == (ssize_t)tail;
+    close(fd);
+    if (!ok) return false;
+
+    stamp = RosterStamp();
+    stamp.size = size;
+    stamp.mtimeNs = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    stamp.sampleCrc = crc32(sample.data(), sample.size());
+    return true;
+}
+
+size_t snapshotHeadroom(size_t count) {
+    return count / 16 + 1024;
+}
+
+bool PayrollStore::saveSnapshot(const std::string& file, const RosterStamp& stamp,
+    const PayrollStore* const* stores, size_t count, const EngineState* state) {
+    // Index positions are only meaningful for a single store
+    if (state && (count != 1 || state->generation == 0)) return false;
+
+    SnapshotHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = SNAPSHOT_MAGIC;
+    h.version = SNAPSHOT_VERSION;
+    h.source = stamp;
+    for (size_t i = 0; i < count; i++) {
+        h.employees += stores[i]->size();
+        h.counts[SALARIED] += stores[i]->salaried.ids.size();
+        h.counts[HOURLY] += stores[i]->hourly.ids.size();
+        h.counts[COMMISSION] += stores[i]->commission.ids.size();
+        h.nameBytes += stores[i]->nameTable.size();
+    }
+    h.headroom = snapshotHeadroom(h.employees);
+    if (h.employees + h.headroom > UINT32_MAX || h.nameBytes + h.headroom * NAME_ROOM > UINT32_MAX) return false;
+    if (state) {
+        h.generation = state->generation;
+        h.indexSlots = state->index.capacity();
+        h.indexCount = state->index.size();
+        for (int t = 0; t < 3; t++) {
+            h.running[t][0] = state->running[t].sum;
+            h.running[t][1] = state->running[t].compensation;
+        }
+    }
+    h.crc = headerCrc(h);
+
+    size_t offsets[SECTION_COUNT];
+    size_t fileSize = layout(h, offsets);
+
+    std::string tmp = file + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    SnapshotWriter out(fd);
+    unsigned char header[HEADER_SIZE] = {};
+    memcpy(header, &h, sizeof(h));
+    out.put(header, HEADER_SIZE);
+
+    for (int k = 0; k < SECTION_COUNT; k++) {
+        out.padTo(offsets[k]);
+        // Rows and name offsets restart in every store, so rebase them onto
+        // the stores written before it
+        uint32_t rowBase[3] = {};
+        uint32_t nameBase = 0;
+        for (size_t i = 0; i < count; i++) {
+            const PayrollStore& store = *stores[i];
+            if (k == ID_INDEX) {
+                if (state) out.put(state->index.data(), h.indexSlots * sizeof(IdIndex::Entry));
+            }
+            else if (k == ORDER) {
+                const Column<RosterSlot>& order = store.fileOrder();
+                for (size_t r = 0; r < order.size(); r++) {
+                    RosterSlot slot = order[r];
+                    if (slot.type != REMOVED_SLOT) slot.row += rowBase[slot.type];
+                    out.put(&slot, sizeof(slot));
+                }
+            }
+            else if (k == SALARIED_NAMES || k == HOURLY_NAMES || k == COMMISSION_NAMES) {
+                const Column<NameRef>& names = nameColumn(store, k);
+                for (size_t r = 0; r < names.size(); r++) {
+                    NameRef ref = { names[r].offset + nameBase, names[r].length };
+                    out.put(&ref, sizeof(ref));
+                }
+            }
+            else {
+                size_t bytes;
+                const void* data = sectionData(store, k, bytes);
+                out.put(data, bytes);
+            }
+            rowBase[SALARIED] += store.salaried.ids.size();
+            rowBase[HOURLY] += store.hourly.ids.size();
+            rowBase[COMMISSION] += store.commission.ids.size();
+            nameBase += store.nameTable.size();
+        }
+    }
+    out.padTo(fileSize);
+
+    bool ok = out.finish();
+    close(fd);
+    if (!ok) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return rename(tmp.c_str(), file.c_str()) == 0;
+}
+
+uint64_t PayrollStore::snapshotGeneration(const std::string& file) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) return 0;
+    SnapshotHeader h;
+    bool ok = pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h)
+        && h.magic == SNAPSHOT_MAGIC && h.version == SNAPSHOT_VERSION && h.crc == headerCrc(h);
+    close(fd);
+    return ok ? h.generation : 0;
+}
+
+bool PayrollStore::loadSnapshot(const std::string& file, const RosterStamp& stamp, EngineState* state) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    SnapshotHeader h;
+    size_t offsets[SECTION_COUNT];
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < HEADER_SIZE
+        || pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)
+        || h.magic != SNAPSHOT_MAGIC || h.version != SNAPSHOT_VERSION || h.crc != headerCrc(h)
+        || h.headroom > UINT32_MAX || h.employees + h.headroom > UINT32_MAX
+        || h.nameBytes + h.headroom * NAME_ROOM > UINT32_MAX
+        || h.indexSlots > UINT32_MAX || (h.generation == 0 && h.indexSlots != 0)
+        || layout(h, offsets) != (size_t)st.st_size) {
+        close(fd);
+        return false;
+    }
+
+    // A snapshot of some other version of the roster is stale
+    if (h.source.size != stamp.size || h.source.mtimeNs != stamp.mtimeNs || h.source.sampleCrc != stamp.sampleCrc) {
+        close(fd);
+        return false;
+    }
+
+    // Private writable mapping, so in-place updates copy only the pages they touch
+    void* m = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) return false;
+
+    PayrollStore loaded;
+    size_t size = st.st_size;
+    loaded.mapping = std::shared_ptr<void>(m, [size](void* p) { munmap(p, size); });
+
+    char* base = static_cast<char*>(m);
+    auto at = [&](int section) { return base + offsets[section]; };
+    size_t s = h.counts[SALARIED], hr = h.counts[HOURLY], c = h.counts[COMMISSION], room = h.headroom;
+
+    loaded.order.attach(reinterpret_cast<RosterSlot*>(at(ORDER)), h.employees, h.employees + room);
+    loaded.salaried.ids.attach(reinterpret_cast<int*>(at(SALARIED_IDS)), s, s + room);
+    loaded.salaried.names.attach(reinterpret_cast<NameRef*>(at(SALARIED_NAMES)), s, s + room);
+    loaded.salaried.monthlySalary.attach(reinterpret_cast<double*>(at(SALARIED_SALARY)), s, s + room);
+    loaded.hourly.ids.attach(reinterpret_cast<int*>(at(HOURLY_IDS)), hr, hr + room);
+    loaded.hourly.names.attach(reinterpret_cast<NameRef*>(at(HOURLY_NAMES)), hr, hr + room);
+    loaded.hourly.hourlyRate.attach(reinterpret_cast<double*>(at(HOURLY_RATE)), hr, hr + room);
+    loaded.hourly.hoursWorked.attach(reinterpret_cast<int*>(at(HOURLY_HOURS)), hr, hr + room);
+    loaded.commission.ids.attach(reinterpret_cast<int*>(at(COMMISSION_IDS)), c, c + room);
+    loaded.commission.names.attach(reinterpret_cast<NameRef*>(at(COMMISSION_NAMES)), c, c + room);
+    loaded.commission.baseSalary.attach(reinterpret_cast<double*>(at(COMMISSION_BASE)), c, c + room);
+    loaded.commission.totalSales.attach(reinterpret_cast<double*>(at(COMMISSION_SALES)), c, c + room);
+    loaded.commission.commissionRate.attach(reinterpret_cast<double*>(at(COMMISSION_RATE)), c, c + room);
+    loaded.nameTable.attach(at(NAME_TABLE), h.nameBytes, h.nameBytes + room * NAME_ROOM);
+    IdIndex::Entry* index = reinterpret_cast<IdIndex::Entry*>(at(ID_INDEX));
+
+    if (!slotsInside(loaded.order, h.counts)
+        || !namesInside(loaded.salaried.names, h.nameBytes)
+        || !namesInside(loaded.hourly.names, h.nameBytes)
+        || !namesInside(loaded.commission.names, h.nameBytes)
+        || !allFinite(loaded.salaried.monthlySalary)
+        || !allFinite(loaded.hourly.hourlyRate)
+        || !allFinite(loaded.commission.baseSalary)
+        || !allFinite(loaded.commission.totalSales)
+        || !allFinite(loaded.commission.commissionRate)
+        || (h.generation != 0 && !indexInside(index, h, loaded.order))) {
+        return false;
+    }
+    *this = std::move(loaded);
+
+    if (state && h.generation != 0) {
+        state->index.attach(index, h.indexSlots, h.indexCount);
+        for (int t = 0; t < 3; t++) {
+            state->running[t].sum = h.running[t][0];
+            state->running[t].compensation = h.running[t][1];
+        }
+        state->ready = true;
+        state->generation = h.generation;
+    }
+    return true;
+}
+
+void benchmarkSnapshot(size_t count) {
+    const char* file = "bench_snapshot.txt";
+    const char* snapshot = "bench_snapshot.snap";
+    writeSyntheticRoster(file, count);
+
+    auto seconds = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    auto report = [](const char* name, double secs) {
+        std::cout << std::setw(18) << std::left << name << std::right << std::fixed << std::setprecision(3)
+            << secs * 1000 << " ms\n";
+    };
+
+    std::cout << "snapshot of " << count << " employees\n";
+    RosterStamp stamp;
+    stampRoster(file, stamp);
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        MappedFile mapped;
+        mapped.open(file);
+        std::vector<RosterChunk> chunks;
+        PayrollSummary summary;
+        runPayroll(mapped.text(), std::thread::hardware_concurrency(), chunks, summary);
+        report("text load", seconds(start));
+
+        std::vector<const PayrollStore*> stores;
+        for (const auto& chunk : chunks) stores.push_back(&chunk.store);
+        start = std::chrono::steady_clock::now();
+        PayrollStore::saveSnapshot(snapshot, stamp, stores.data(), stores.size());
+        report("snapshot write", seconds(start));
+    }
+
+    start = std::chrono::steady_clock::now();
+    RosterStamp current;
+    PayrollStore store;
+    bool loaded = stampRoster(file, current) && store.loadSnapshot(snapshot, current);
+    report("snapshot load", seconds(start));
+    if (!loaded) std::cout << "snapshot load FAILED\n";
+
+    start = std::chrono::steady_clock::now();
+    PayrollTotals totals = store.totals();
+    report("first payroll", seconds(start));
+    std::cout << "  " << store.size() << " employees, total $" << std::setprecision(2) << totals.total() << "\n";
+
+    unlink(file);
+    unlink(snapshot);
+}
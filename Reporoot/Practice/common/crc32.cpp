@@ -0,0 +1,30 @@
+#include "crc32.h"
+
+namespace {
+
+struct CrcTable {
+    uint32_t entry[256];
+};
+
+// Built at compile time, so threads can checksum without any set-up race
+constexpr CrcTable buildTable() {
+    CrcTable table = {};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        table.entry[i] = c;
+    }
+    return table;
+}
+
+constexpr CrcTable CRC_TABLE = buildTable();
+
+}
+
+uint32_t crc32(const unsigned char* data, size_t len) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++)
+        crc = CRC_TABLE.entry[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
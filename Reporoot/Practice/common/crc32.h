@@ -0,0 +1,11 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Standard CRC-32 (IEEE 802.3), used to check log records, snapshot headers
+// and roster stamps
+uint32_t crc32(const unsigned char* data, size_t len);
+
+#endif
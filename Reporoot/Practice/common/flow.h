@@ -0,0 +1,234 @@
+#ifndef FLOW_H
+#define FLOW_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ingest.h"
+#include "reduce.h"
+
+// Lazy single-pass pipelines. Stages are chained with | onto a sink, and
+// the chain becomes one nested callable that the source calls per value,
+// so the compiler fuses every stage into the read loop and nothing is
+// stored between them:
+//
+//     Reduction total = { 0, false };
+//     flow::run(STDIN_FILENO, flow::map(square) | flow::tee(print, flow::sumInto(total)));
+//
+// A sink is any callable taking a value. Accumulating sinks write through
+// a reference, so results outlive the copies the chain makes.
+
+namespace flow {
+
+template <class F, class Next>
+struct MapStage {
+    F f;
+    Next next;
+    template <class T> void operator()(const T& value) { next(f(value)); }
+};
+
+template <class P, class Next>
+struct FilterStage {
+    P keep;
+    Next next;
+    template <class T> void operator()(const T& value) {
+        if (keep(value)) next(value);
+    }
+};
+
+// Each value goes to both consumers, first then second
+template <class A, class B>
+struct TeeStage {
+    A first;
+    B second;
+    template <class T> void operator()(const T& value) {
+        first(value);
+        second(value);
+    }
+};
+
+template <class T, class Op>
+struct ReduceSink {
+    T* result;
+    Op op;
+    template <class V> void operator()(const V& value) { *result = op(*result, value); }
+};
+
+struct SumSink {
+    Reduction* result;
+    template <class V> void operator()(const V& value) { result->value += value; }
+};
+
+// Checked like reduceProduct(): after an overflow only a zero matters
+struct ProductSink {
+    Reduction* result;
+    template <class V> void operator()(const V& value) {
+        if (value == 0) *result = { 0, false };
+        else if (!result->overflow && __builtin_mul_overflow(result->value, (__int128)value, &result->value)) {
+            result->overflow = true;
+        }
+    }
+};
+
+// Unbound stages, which bind() wraps around the rest of the chain
+template <class F>
+struct Map {
+    F f;
+    template <class Next> MapStage<F, Next> bind(Next next) const { return { f, next }; }
+};
+
+template <class P>
+struct Filter {
+    P keep;
+    template <class Next> FilterStage<P, Next> bind(Next next) const { return { keep, next }; }
+};
+
+template <class A, class B>
+struct Chain {
+    A first;
+    B second;
+    template <class Next> auto bind(Next next) const { return first.bind(second.bind(next)); }
+};
+
+template <class T> struct IsStage : std::false_type {};
+template <class F> struct IsStage<Map<F>> : std::true_type {};
+template <class P> struct IsStage<Filter<P>> : std::true_type {};
+template <class A, class B> struct IsStage<Chain<A, B>> : std::true_type {};
+
+template <class F> Map<F> map(F f) { return { f }; }
+template <class P> Filter<P> filter(P keep) { return { keep }; }
+template <class A, class B> TeeStage<A, B> tee(A first, B second) { return { first, second }; }
+template <class T, class Op> ReduceSink<T, Op> reduce(T& result, Op op) { return { &result, op }; }
+inline SumSink sumInto(Reduction& result) { return { &result }; }
+inline ProductSink productInto(Reduction& result) { return { &result }; }
+
+template <class A, class B, class = std::enable_if_t<IsStage<A>::value && IsStage<B>::value>>
+Chain<A, B> operator|(A first, B second) {
+    return { first, second };
+}
+
+template <class A, class Sink, class = std::enable_if_t<IsStage<A>::value && !IsStage<Sink>::value>, class = void>
+auto operator|(A stage, Sink sink) {
+    return stage.bind(sink);
+}
+
+// Push every integer from fd, up to a -1, through sink in one pass. Memory
+// use is one read block whatever the input size.
+template <class Sink>
+bool run(int fd, Sink sink) {
+    return forEachInteger(fd, sink);
+}
+
+template <class Sink>
+void run(const int* data, size_t n, Sink sink) {
+    for (size_t i = 0; i < n; i++) sink(data[i]);
+}
+
+namespace detail {
+
+inline long peakRssKb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return std::atol(line.c_str() + 6);
+    }
+    return -1;
+}
+
+// Writing 5 to clear_refs resets the peak to the current RSS
+inline void resetPeakRss() {
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+}
+
+}
+
+// Time and peak memory of the Practice05_3a job (print each square, then
+// their sum) over a file of count integers: stored and walked twice, as
+// before, against one fused pass
+inline void benchmarkFlow(size_t count) {
+    const char* file = "bench_flow.txt";
+    {
+        std::ofstream out(file);
+        std::mt19937 rng(19);
+        for (size_t i = 0; i < count; i++) {
+            int v = (int)(rng() % 2000001) - 1000000;
+            if (v == -1) v = 1;
+            out << v << (i % 16 == 15 ? '\n' : ' ');
+        }
+        out << "-1\n";
+    }
+
+    auto square = [](int x) { return (long long)x * x; };
+    auto measure = [&](const char* name, auto run) {
+        detail::resetPeakRss();
+        long rssBefore = detail::peakRssKb();
+        auto start = std::chrono::steady_clock::now();
+        std::string result = run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << std::setw(24) << std::left << name << std::right << std::fixed << std::setprecision(3)
+            << seconds << " s  peak +" << std::setw(6) << (detail::peakRssKb() - rssBefore) / 1024 << " MiB  "
+            << result << "\n";
+    };
+
+    std::cout << "print squares and sum them, " << count << " integers\n";
+    measure("iostream, two passes", [&] {
+        std::ifstream in(file);
+        std::ofstream out("/dev/null");
+        std::vector<int> numbers;
+        int num;
+        while (in >> num && num != -1) {
+            numbers.push_back(num);
+        }
+        // int arithmetic as before, made to wrap explicitly rather than by overflowing
+        auto wrappedSquare = [](int x) { return (int)((unsigned)x * (unsigned)x); };
+        std::for_each(numbers.begin(), numbers.end(), [&](int x) { out << wrappedSquare(x) << " "; });
+        int sum = std::accumulate(numbers.begin(), numbers.end(), 0, [&](int total, int x) {
+            return (int)((unsigned)total + (unsigned)wrappedSquare(x));
+        });
+        return std::to_string(sum) + " (wrapped)";
+    });
+    measure("bulk read, two passes", [&] {
+        std::ofstream out("/dev/null");
+        std::vector<int> numbers;
+        readIntegers(std::string(file), numbers);
+        std::for_each(numbers.begin(), numbers.end(), [&](int x) { out << square(x) << " "; });
+        return toString(reduceSumSquares(numbers.data(), numbers.size()).value);
+    });
+    measure("fused", [&] {
+        std::ofstream out("/dev/null");
+        Reduction sum = { 0, false };
+        int fd = open(file, O_RDONLY);
+        run(fd, map(square) | tee([&out](long long sq) { out << sq << " "; }, sumInto(sum)));
+        close(fd);
+        return toString(sum.value);
+    });
+    measure("bulk read, sum only", [&] {
+        std::vector<int> numbers;
+        readIntegers(std::string(file), numbers);
+        return toString(reduceSumSquares(numbers.data(), numbers.size()).value);
+    });
+    measure("fused, sum only", [&] {
+        Reduction sum = { 0, false };
+        int fd = open(file, O_RDONLY);
+        run(fd, map(square) | sumInto(sum));
+        close(fd);
+        return toString(sum.value);
+    });
+    unlink(file);
+}
+
+}
+
+#endif
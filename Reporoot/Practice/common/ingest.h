@@ -0,0 +1,214 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Bulk replacement for
+//     while (std::cin >> num && num != -1) numbers.push_back(num);
+// Input is read in large blocks, or mapped when it is a regular file, and
+// parsed with std::from_chars. Reading stops where that loop would: at -1,
+// at end of input, or at the first token that is not an int (including one
+// out of range). Unlike std::cin, input past the stopping point may have
+// been consumed.
+
+namespace ingest_detail {
+
+const size_t BLOCK_BYTES = 1 << 20;
+
+inline bool isSpace(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Parse integers from [p, end), handing each to sink. Unless last is set, a
+// number that runs into end may continue in the next block, so parsing
+// stops in front of it and returns its start. done is set once reading
+// should stop for good: at -1, at a token that cannot start an int, or at
+// one too large for an int, which no further digits can fix.
+template <class Sink>
+const char* scan(const char* p, const char* end, bool last, Sink& sink, bool& done) {
+    while (true) {
+        while (p != end && isSpace(*p)) p++;
+        if (p == end) return p;
+
+        const char* digits = p + (*p == '+' || *p == '-');
+        if (digits == end) {
+            done = last;
+            return p;
+        }
+        if (*digits < '0' || *digits > '9') {
+            done = true;
+            return p;
+        }
+        // operator>> takes a leading '+', std::from_chars does not
+        int value = 0;
+        std::from_chars_result r = std::from_chars(*p == '+' ? digits : p, end, value);
+        if (r.ptr == end && r.ec == std::errc() && !last) return p;
+        if (r.ec != std::errc() || value == -1) {
+            done = true;
+            return p;
+        }
+        sink(value);
+        p = r.ptr;
+    }
+}
+
+// Shrink the unfinished number at the front of a block to its sign and
+// significant digits and return its new length. scan has already ruled out
+// overflow, so what is carried to the next read stays a few bytes however
+// long the number is written.
+inline size_t compactToken(char* token, size_t length) {
+    size_t from = 0;
+    size_t to = 0;
+    if (length > 0 && (token[0] == '+' || token[0] == '-')) from = to = 1;
+    while (from + 1 < length && token[from] == '0') from++;
+    memmove(token + to, token + from, length - from);
+    return to + length - from;
+}
+
+// A guess at how many values fill size bytes, from how densely the first
+// block is packed, so out is sized once up front
+inline void reserveFor(const char* sample, size_t sampleSize, size_t size, std::vector<int>& out) {
+    size_t tokens = 0;
+    for (size_t i = 1; i < sampleSize; i++) {
+        tokens += isSpace(sample[i]) && !isSpace(sample[i - 1]);
+    }
+    if (sampleSize > 0) {
+        out.reserve(out.size() + (size_t)((double)size / sampleSize * (tokens + 1) * 1.05) + 16);
+    }
+}
+
+inline bool readMapped(int fd, off_t offset, size_t size, std::vector<int>& out) {
+    if (size <= (size_t)offset) return true;
+    void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) return false;
+    madvise(base, size, MADV_SEQUENTIAL);
+    const char* begin = (const char*)base + offset;
+    const char* end = (const char*)base + size;
+    reserveFor(begin, std::min<size_t>(end - begin, BLOCK_BYTES), end - begin, out);
+    bool done = false;
+    auto append = [&out](int value) { out.push_back(value); };
+    scan(begin, end, true, append, done);
+    munmap(base, size);
+    return true;
+}
+
+// Memory use stays at one block however long the input is
+template <class Sink>
+bool readBlocks(int fd, Sink& sink) {
+    std::vector<char> buffer(BLOCK_BYTES);
+    size_t kept = 0;  // bytes of an unfinished number carried to the front
+    bool done = false;
+    while (!done) {
+        ssize_t n = read(fd, buffer.data() + kept, buffer.size() - kept);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        const char* begin = buffer.data();
+        const char* end = begin + kept + n;
+        const char* rest = scan(begin, end, n == 0, sink, done);
+        if (n == 0) break;
+        memmove(buffer.data(), rest, end - rest);
+        kept = compactToken(buffer.data(), end - rest);
+    }
+    return true;
+}
+
+}
+
+// Append integers read from fd onto out. False on a read error.
+inline bool readIntegers(int fd, std::vector<int>& out) {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        off_t offset = lseek(fd, 0, SEEK_CUR);
+        if (offset >= 0 && ingest_detail::readMapped(fd, offset, st.st_size, out)) return true;
+    }
+    auto append = [&out](int value) { out.push_back(value); };
+    return ingest_detail::readBlocks(fd, append);
+}
+
+// Hand each integer read from fd to sink as it is parsed, without storing
+// them. False on a read error.
+template <class Sink>
+bool forEachInteger(int fd, Sink& sink) {
+    return ingest_detail::readBlocks(fd, sink);
+}
+
+inline bool readIntegers(const std::string& file, std::vector<int>& out) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = readIntegers(fd, out);
+    close(fd);
+    return ok;
+}
+
+// From standard input, flushing std::cout first as std::cin would
+inline bool readStdinIntegers(std::vector<int>& out) {
+    std::cout.flush();
+    return readIntegers(STDIN_FILENO, out);
+}
+
+// Time the std::cin-style loop against block reads and mapping on a file
+// of count integers ending in -1
+inline void benchmarkIngest(size_t count) {
+    const char* file = "bench_ingest.txt";
+    {
+        std::ofstream out(file);
+        std::mt19937 rng(11);
+        for (size_t i = 0; i < count; i++) {
+            int v = (int)(rng() % 2000001) - 1000000;
+            if (v == -1) v = 1;
+            out << v << (i % 16 == 15 ? '\n' : ' ');
+        }
+        out << "-1\n";
+    }
+    std::ifstream probe(file, std::ios::binary | std::ios::ate);
+    double megabytes = (double)probe.tellg() / (1 << 20);
+
+    std::vector<int> expected;
+    auto measure = [&](const char* name, auto run) {
+        std::vector<int> numbers;
+        auto start = std::chrono::steady_clock::now();
+        run(numbers);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (expected.empty()) expected = numbers;
+        std::cout << std::setw(14) << std::left << name << std::right << std::fixed << std::setprecision(3)
+            << secs << " s  " << std::setprecision(1) << numbers.size() / secs / 1e6 << "M ints/s  "
+            << megabytes / secs << " MiB/s" << (numbers == expected ? "" : "  MISMATCH") << "\n";
+    };
+
+    std::cout << "ingest of " << count << " integers (" << std::fixed << std::setprecision(1) << megabytes << " MiB)\n";
+    measure("iostream", [&](std::vector<int>& numbers) {
+        std::ifstream in(file);
+        int num;
+        while (in >> num && num != -1) {
+            numbers.push_back(num);
+        }
+    });
+    measure("block read", [&](std::vector<int>& numbers) {
+        int fd = open(file, O_RDONLY);
+        auto append = [&numbers](int value) { numbers.push_back(value); };
+        ingest_detail::readBlocks(fd, append);
+        close(fd);
+    });
+    measure("mmap", [&](std::vector<int>& numbers) { readIntegers(file, numbers); });
+    unlink(file);
+}
+
+#endif
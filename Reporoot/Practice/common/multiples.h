@@ -0,0 +1,219 @@
+#ifndef MULTIPLES_H
+#define MULTIPLES_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "parallel.h"
+#include "reduce.h"
+
+// Divisibility by a fixed divisor with a multiply, a rotate and a compare
+// instead of a division. For |d| = 2^shift * odd, |x| is a multiple of d
+// exactly when rotr(|x| * inverse(odd), shift) <= (2^32 - 1) / |d|, all
+// mod 2^32. A divisor of 0 matches only 0.
+struct DivisorTest {
+    uint32_t inverse;  // of the odd part of |d|, mod 2^32
+    uint32_t shift;    // trailing zero bits of |d|
+    uint32_t limit;
+
+    static DivisorTest make(int divisor) {
+        uint32_t d = divisor < 0 ? 0u - (uint32_t)divisor : (uint32_t)divisor;
+        if (d == 0) return { 1, 0, 0 };
+        uint32_t shift = __builtin_ctz(d);
+        uint32_t odd = d >> shift;
+        // Newton's iteration doubles the correct low bits: 3, 6, 12, 24, 48
+        uint32_t inverse = odd;
+        for (int i = 0; i < 4; i++) inverse *= 2 - odd * inverse;
+        return { inverse, shift, 0xFFFFFFFFu / d };
+    }
+
+    bool matches(int x) const {
+        uint32_t u = x < 0 ? 0u - (uint32_t)x : (uint32_t)x;
+        uint32_t m = u * inverse;
+        uint32_t r = shift == 0 ? m : (m >> shift) | (m << (32 - shift));
+        return r <= limit;
+    }
+};
+
+namespace multiples_detail {
+
+// Values per tile: each tile is read from memory once and then tested
+// against every divisor while it sits in L1
+const size_t TILE = 2048;
+
+// Bit i of words is set when data[i] matches; first is a multiple of 64
+inline void matchScalar(const DivisorTest& test, const int* data, size_t first, size_t last, uint64_t* words) {
+    for (size_t i = first; i < last; i += 64) {
+        uint64_t word = 0;
+        size_t end = std::min(last, i + 64);
+        for (size_t k = i; k < end; k++) word |= (uint64_t)test.matches(data[k]) << (k - i);
+        words[i / 64] = word;
+    }
+}
+
+#ifdef REDUCE_X86
+
+// Whole groups of 8 values; each group's 8 results are one bitmap byte
+__attribute__((target("avx2")))
+inline void matchAvx2(const DivisorTest& test, const int* data, size_t first, size_t last, uint64_t* words) {
+    const __m256i inverse = _mm256_set1_epi32((int)test.inverse);
+    const __m256i limit = _mm256_set1_epi32((int)test.limit);
+    const __m128i right = _mm_cvtsi32_si128((int)test.shift);
+    const __m128i left = _mm_cvtsi32_si128(32 - (int)test.shift);  // 32 shifts everything out
+    uint8_t* bytes = (uint8_t*)words;
+    for (size_t i = first; i < last; i += 8) {
+        __m256i u = _mm256_abs_epi32(_mm256_loadu_si256((const __m256i*)(data + i)));
+        __m256i m = _mm256_mullo_epi32(u, inverse);
+        __m256i r = _mm256_or_si256(_mm256_srl_epi32(m, right), _mm256_sll_epi32(m, left));
+        __m256i hit = _mm256_cmpeq_epi32(_mm256_min_epu32(r, limit), r);
+        bytes[i / 8] = (uint8_t)_mm256_movemask_ps(_mm256_castsi256_ps(hit));
+    }
+}
+
+__attribute__((target("sse4.2")))
+inline void matchSse42(const DivisorTest& test, const int* data, size_t first, size_t last, uint64_t* words) {
+    const __m128i inverse = _mm_set1_epi32((int)test.inverse);
+    const __m128i limit = _mm_set1_epi32((int)test.limit);
+    const __m128i right = _mm_cvtsi32_si128((int)test.shift);
+    const __m128i left = _mm_cvtsi32_si128(32 - (int)test.shift);
+    uint8_t* bytes = (uint8_t*)words;
+    for (size_t i = first; i < last; i += 8) {
+        int mask = 0;
+        for (int half = 0; half < 2; half++) {
+            __m128i u = _mm_abs_epi32(_mm_loadu_si128((const __m128i*)(data + i + half * 4)));
+            __m128i m = _mm_mullo_epi32(u, inverse);
+            __m128i r = _mm_or_si128(_mm_srl_epi32(m, right), _mm_sll_epi32(m, left));
+            __m128i hit = _mm_cmpeq_epi32(_mm_min_epu32(r, limit), r);
+            mask |= _mm_movemask_ps(_mm_castsi128_ps(hit)) << (half * 4);
+        }
+        bytes[i / 8] = (uint8_t)mask;
+    }
+}
+
+#endif
+
+// Match data[first, last) against one divisor. The SIMD kernels write
+// whole bytes, which on x86 sit in the little-endian words where the
+// scalar kernel would put the same bits.
+inline void matchRange(const DivisorTest& test, const int* data, size_t first, size_t last, uint64_t* words,
+        SimdLevel level) {
+#ifdef REDUCE_X86
+    if (level != SIMD_SCALAR) {
+        size_t whole = first + (last - first) / 64 * 64;
+        if (level == SIMD_AVX2) matchAvx2(test, data, first, whole, words);
+        else matchSse42(test, data, first, whole, words);
+        first = whole;
+    }
+#endif
+    (void)level;
+    if (first < last) matchScalar(test, data, first, last, words);
+}
+
+}
+
+// Finds the multiples of a batch of divisors in one pass over the data and
+// reports them as bitmaps, one per divisor
+class MultiplesFilter {
+public:
+    explicit MultiplesFilter(const std::vector<int>& divisors, SimdLevel level = detectSimd()) : level(level) {
+        for (int d : divisors) tests.push_back(DivisorTest::make(d));
+    }
+
+    size_t divisorCount() const { return tests.size(); }
+
+    // bitmaps[j] gets (n + 63) / 64 words, with bit i set when data[i] is
+    // a multiple of divisor j. Chunks of the data run on pool.
+    void match(const int* data, size_t n, std::vector<std::vector<uint64_t>>& bitmaps,
+            WorkerPool& pool = defaultPool()) const {
+        bitmaps.resize(tests.size());
+        for (auto& bitmap : bitmaps) bitmap.assign((n + 63) / 64, 0);
+        // Chunks, like tiles, start on a word so no two threads share one
+        size_t chunk = cacheChunk(sizeof(int)) / 64 * 64;
+        parallelFor(pool, n, chunk, [&](size_t begin, size_t end) {
+            for (size_t tile = begin; tile < end; tile += multiples_detail::TILE) {
+                size_t tileEnd = std::min(end, tile + multiples_detail::TILE);
+                for (size_t j = 0; j < tests.size(); j++) {
+                    multiples_detail::matchRange(tests[j], data, tile, tileEnd, bitmaps[j].data(), level);
+                }
+            }
+        });
+    }
+
+private:
+    std::vector<DivisorTest> tests;
+    SimdLevel level;
+};
+
+// Positions of the set bits, in order, for data of up to 2^32 values
+inline void bitmapIndices(const std::vector<uint64_t>& bitmap, std::vector<uint32_t>& out) {
+    out.clear();
+    for (size_t w = 0; w < bitmap.size(); w++) {
+        for (uint64_t word = bitmap[w]; word != 0; word &= word - 1) {
+            out.push_back((uint32_t)(w * 64 + __builtin_ctzll(word)));
+        }
+    }
+}
+
+// Time the printing % loop against the filter for 1, 8 and 64 divisors
+// over count values, checking the filter's bitmaps against %
+inline void benchmarkMultiples(size_t count) {
+    std::vector<int> values(count);
+    std::mt19937 rng(31);
+    for (auto& v : values) v = (int)rng();
+    std::vector<int> divisors(64);
+    for (auto& d : divisors) d = 2 + (int)(rng() % 999);
+
+    auto seconds = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    auto report = [&](size_t batch, const char* name, double secs, double base) {
+        std::cout << std::setw(9) << batch << "  " << std::setw(16) << std::left << name << std::right << std::fixed
+            << std::setprecision(2) << std::setw(10) << secs * 1000 << " ms " << std::setw(8)
+            << count * batch / secs / 1e9 << " Gtests/s " << std::setprecision(1) << std::setw(7) << base / secs << "x\n";
+    };
+
+    std::cout << "multiples of 1, 8 and 64 divisors over " << count << " values\n";
+    bool agree = true;
+    for (size_t batch : { 1, 8, 64 }) {
+        std::vector<int> some(divisors.begin(), divisors.begin() + batch);
+
+        // The original loop: a division and a formatted write per match
+        auto start = std::chrono::steady_clock::now();
+        {
+            std::ofstream out("/dev/null");
+            for (int d : some) {
+                for (int num : values) if (num % d == 0) out << num << " ";
+                out << "\n";
+            }
+        }
+        double base = seconds(start);
+        report(batch, "% and print", base, base);
+
+        start = std::chrono::steady_clock::now();
+        std::vector<std::vector<uint64_t>> expected(batch, std::vector<uint64_t>((count + 63) / 64, 0));
+        for (size_t j = 0; j < batch; j++) {
+            for (size_t i = 0; i < count; i++) {
+                if (values[i] % some[j] == 0) expected[j][i / 64] |= (uint64_t)1 << (i % 64);
+            }
+        }
+        report(batch, "% to bitmap", seconds(start), base);
+
+        for (int l = SIMD_SCALAR; l <= detectSimd(); l++) {
+            MultiplesFilter filter(some, (SimdLevel)l);
+            std::vector<std::vector<uint64_t>> bitmaps;
+            start = std::chrono::steady_clock::now();
+            filter.match(values.data(), count, bitmaps);
+            report(batch, (std::string("filter ") + simdName((SimdLevel)l)).c_str(), seconds(start), base);
+            agree = agree && bitmaps == expected;
+        }
+    }
+    std::cout << "bitmaps " << (agree ? "match" : "DIFFER from") << " %\n";
+}
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// Persistent worker threads for data-parallel loops. A job is a number of
+// tasks; the workers and the calling thread claim task indices from one
+// shared counter until none are left, so faster threads simply take more.
+class WorkerPool {
+public:
+    // threads counts the caller, so a pool of 1 runs everything inline
+    explicit WorkerPool(unsigned threads) : next(0), taskCount(0), job(nullptr), call(nullptr), generation(0), busy(0),
+          stopping(false) {
+        for (unsigned i = 1; i < threads; i++) {
+            workers.emplace_back([this] { loop(); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    unsigned size() const { return (unsigned)workers.size() + 1; }
+
+    // Call fn(task) for every task in [0, tasks) and return once all are done
+    template <class F>
+    void run(size_t tasks, F& fn) {
+        if (workers.empty() || tasks <= 1) {
+            for (size_t t = 0; t < tasks; t++) fn(t);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            call = [](void* f, size_t task) { (*(F*)f)(task); };
+            taskCount = tasks;
+            next = 0;
+            busy = workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        work();
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return busy == 0; });
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::atomic<size_t> next;
+    size_t taskCount;
+    void* job;
+    void (*call)(void*, size_t);
+    size_t generation;  // bumped for each job so workers can tell it is new
+    size_t busy;        // workers not yet finished with the current job
+    bool stopping;
+
+    void work() {
+        for (size_t task; (task = next.fetch_add(1)) < taskCount;) {
+            call(job, task);
+        }
+    }
+
+    void loop() {
+        size_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            work();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy == 0) done.notify_one();
+        }
+    }
+};
+
+// One worker per hardware thread, started on first use
+inline WorkerPool& defaultPool() {
+    static WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+// Below this many chunks a loop runs on the calling thread, where waking
+// the pool would cost more than it saves
+const size_t PARALLEL_MIN_CHUNKS = 4;
+
+// Elements per chunk: half the L2 cache, so a chunk stays cache resident
+// while one thread works through it
+inline size_t cacheChunk(size_t elementSize) {
+    static const size_t l2 = [] {
+        long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        return size > 0 ? (size_t)size : (size_t)1 << 20;
+    }();
+    return std::max<size_t>(l2 / 2 / elementSize, 4096);
+}
+
+// Call fn(begin, end) over [0, n) in chunks of chunk elements. The chunks
+// are the same whatever the pool size; only who runs them changes.
+template <class F>
+void parallelFor(WorkerPool& pool, size_t n, size_t chunk, F fn) {
+    size_t chunks = (n + chunk - 1) / chunk;
+    auto task = [&](size_t c) { fn(c * chunk, std::min(n, (c + 1) * chunk)); };
+    if (chunks < PARALLEL_MIN_CHUNKS) {
+        for (size_t c = 0; c < chunks; c++) task(c);
+        return;
+    }
+    pool.run(chunks, task);
+}
+
+// Reduce each chunk with chunkValue(begin, end), then fold the results
+// into init in chunk order, so the answer never depends on scheduling
+template <class T, class F, class Combine>
+T parallelReduce(WorkerPool& pool, size_t n, size_t chunk, T init, F chunkValue, Combine combine) {
+    std::vector<T> partials((n + chunk - 1) / chunk);
+    parallelFor(pool, n, chunk, [&](size_t begin, size_t end) { partials[begin / chunk] = chunkValue(begin, end); });
+    for (const T& partial : partials) {
+        init = combine(init, partial);
+    }
+    return init;
+}
+
+#endif
@@ -0,0 +1,359 @@
+#ifndef REDUCE_H
+#define REDUCE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define REDUCE_X86 1
+#include <immintrin.h>
+#endif
+
+// Integer reductions that do not overflow silently. Kernels for AVX2 and
+// SSE4.2 are compiled with function target attributes, so no extra compiler
+// flags are needed, and the widest one the CPU supports is picked at run time.
+//
+// Sums are exact: 32-bit values are widened into 64-bit lanes over blocks
+// short enough that a lane cannot overflow, and blocks are added in 128 bits.
+// Squares are at most 2^62, so a sum of squares fits 128 bits for any
+// in-memory count. Only a product can overflow 128 bits, and that is reported.
+
+enum SimdLevel {
+    SIMD_SCALAR,
+    SIMD_SSE42,
+    SIMD_AVX2
+};
+
+struct Reduction {
+    __int128 value;  // exact unless overflow is set
+    bool overflow;
+};
+
+inline SimdLevel detectSimd() {
+    static const SimdLevel level = [] {
+#ifdef REDUCE_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+        if (__builtin_cpu_supports("sse4.2")) return SIMD_SSE42;
+#endif
+        return SIMD_SCALAR;
+    }();
+    return level;
+}
+
+inline const char* simdName(SimdLevel level) {
+    static const char* const names[3] = { "scalar", "sse4.2", "avx2" };
+    return names[level];
+}
+
+inline std::string toString(__int128 value) {
+    unsigned __int128 magnitude = value < 0 ? -(unsigned __int128)value : (unsigned __int128)value;
+    std::string digits;
+    do {
+        digits += (char)('0' + (int)(magnitude % 10));
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0) digits += '-';
+    return std::string(digits.rbegin(), digits.rend());
+}
+
+inline std::ostream& operator<<(std::ostream& out, const Reduction& r) {
+    return r.overflow ? out << "overflow" : out << toString(r.value);
+}
+
+namespace reduce_detail {
+
+// Elements per block; 2^28 values of at most 2^31 cannot overflow a 64-bit lane
+const size_t BLOCK = size_t(1) << 28;
+
+// Sum of the values with (x & mask) == 0; a mask of 0 takes every value
+inline long long sumScalar(const int* data, size_t n, int mask) {
+    long long sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        if ((data[i] & mask) == 0) sum += data[i];
+    }
+    return sum;
+}
+
+inline unsigned __int128 squaresScalar(const int* data, size_t n) {
+    unsigned __int128 sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += (unsigned long long)((long long)data[i] * data[i]);
+    }
+    return sum;
+}
+
+inline bool hasZeroScalar(const int* data, size_t n) {
+    return std::find(data, data + n, 0) != data + n;
+}
+
+#ifdef REDUCE_X86
+
+__attribute__((target("avx2")))
+inline long long sumAvx2(const int* data, size_t n, int mask) {
+    const __m256i bits = _mm256_set1_epi32(mask);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i low = zero, high = zero;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        v = _mm256_and_si256(v, _mm256_cmpeq_epi32(_mm256_and_si256(v, bits), zero));
+        low = _mm256_add_epi64(low, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+        high = _mm256_add_epi64(high, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+    }
+    alignas(32) long long lanes[4];
+    _mm256_store_si256((__m256i*)lanes, _mm256_add_epi64(low, high));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sumScalar(data + i, n - i, mask);
+}
+
+// Squares are added into unsigned 64-bit lanes; a lane that wraps comes out
+// smaller than what was added, and that carry is counted separately
+__attribute__((target("avx2")))
+inline unsigned __int128 squaresAvx2(const int* data, size_t n) {
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    __m256i sums[2] = { _mm256_setzero_si256(), _mm256_setzero_si256() };
+    __m256i carries[2] = { _mm256_setzero_si256(), _mm256_setzero_si256() };
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i halves[2] = { _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)),
+            _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)) };
+        for (int h = 0; h < 2; h++) {
+            __m256i square = _mm256_mul_epi32(halves[h], halves[h]);
+            sums[h] = _mm256_add_epi64(sums[h], square);
+            __m256i wrapped = _mm256_cmpgt_epi64(_mm256_xor_si256(square, sign), _mm256_xor_si256(sums[h], sign));
+            carries[h] = _mm256_sub_epi64(carries[h], wrapped);
+        }
+    }
+    alignas(32) unsigned long long lanes[2][4], carried[2][4];
+    unsigned __int128 total = squaresScalar(data + i, n - i);
+    for (int h = 0; h < 2; h++) {
+        _mm256_store_si256((__m256i*)lanes[h], sums[h]);
+        _mm256_store_si256((__m256i*)carried[h], carries[h]);
+        for (int k = 0; k < 4; k++) total += ((unsigned __int128)carried[h][k] << 64) + lanes[h][k];
+    }
+    return total;
+}
+
+__attribute__((target("avx2")))
+inline bool hasZeroAvx2(const int* data, size_t n) {
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i a = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(data + i)), zero);
+        __m256i b = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(data + i + 8)), zero);
+        __m256i c = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(data + i + 16)), zero);
+        __m256i d = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(data + i + 24)), zero);
+        if (!_mm256_testz_si256(_mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d)),
+                _mm256_set1_epi32(-1))) return true;
+    }
+    return hasZeroScalar(data + i, n - i);
+}
+
+__attribute__((target("sse4.2")))
+inline long long sumSse42(const int* data, size_t n, int mask) {
+    const __m128i bits = _mm_set1_epi32(mask);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i low = zero, high = zero;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        v = _mm_and_si128(v, _mm_cmpeq_epi32(_mm_and_si128(v, bits), zero));
+        low = _mm_add_epi64(low, _mm_cvtepi32_epi64(v));
+        high = _mm_add_epi64(high, _mm_cvtepi32_epi64(_mm_srli_si128(v, 8)));
+    }
+    alignas(16) long long lanes[2];
+    _mm_store_si128((__m128i*)lanes, _mm_add_epi64(low, high));
+    return lanes[0] + lanes[1] + sumScalar(data + i, n - i, mask);
+}
+
+__attribute__((target("sse4.2")))
+inline unsigned __int128 squaresSse42(const int* data, size_t n) {
+    const __m128i sign = _mm_set1_epi64x(INT64_MIN);
+    __m128i sums[2] = { _mm_setzero_si128(), _mm_setzero_si128() };
+    __m128i carries[2] = { _mm_setzero_si128(), _mm_setzero_si128() };
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i halves[2] = { _mm_cvtepi32_epi64(v), _mm_cvtepi32_epi64(_mm_srli_si128(v, 8)) };
+        for (int h = 0; h < 2; h++) {
+            __m128i square = _mm_mul_epi32(halves[h], halves[h]);
+            sums[h] = _mm_add_epi64(sums[h], square);
+            __m128i wrapped = _mm_cmpgt_epi64(_mm_xor_si128(square, sign), _mm_xor_si128(sums[h], sign));
+            carries[h] = _mm_sub_epi64(carries[h], wrapped);
+        }
+    }
+    alignas(16) unsigned long long lanes[2][2], carried[2][2];
+    unsigned __int128 total = squaresScalar(data + i, n - i);
+    for (int h = 0; h < 2; h++) {
+        _mm_store_si128((__m128i*)lanes[h], sums[h]);
+        _mm_store_si128((__m128i*)carried[h], carries[h]);
+        for (int k = 0; k < 2; k++) total += ((unsigned __int128)carried[h][k] << 64) + lanes[h][k];
+    }
+    return total;
+}
+
+__attribute__((target("sse4.2")))
+inline bool hasZeroSse42(const int* data, size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(data + i)), zero);
+        __m128i b = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(data + i + 4)), zero);
+        __m128i c = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(data + i + 8)), zero);
+        __m128i d = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(data + i + 12)), zero);
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d))) != 0) return true;
+    }
+    return hasZeroScalar(data + i, n - i);
+}
+
+#endif
+
+inline long long sumBlock(const int* data, size_t n, int mask, SimdLevel level) {
+#ifdef REDUCE_X86
+    if (level == SIMD_AVX2) return sumAvx2(data, n, mask);
+    if (level == SIMD_SSE42) return sumSse42(data, n, mask);
+#endif
+    (void)level;
+    return sumScalar(data, n, mask);
+}
+
+inline unsigned __int128 squaresBlock(const int* data, size_t n, SimdLevel level) {
+#ifdef REDUCE_X86
+    if (level == SIMD_AVX2) return squaresAvx2(data, n);
+    if (level == SIMD_SSE42) return squaresSse42(data, n);
+#endif
+    (void)level;
+    return squaresScalar(data, n);
+}
+
+inline bool hasZero(const int* data, size_t n, SimdLevel level) {
+#ifdef REDUCE_X86
+    if (level == SIMD_AVX2) return hasZeroAvx2(data, n);
+    if (level == SIMD_SSE42) return hasZeroSse42(data, n);
+#endif
+    (void)level;
+    return hasZeroScalar(data, n);
+}
+
+}
+
+// Sum of the values x with (x & mask) == 0, e.g. a mask of 1 sums the even values
+inline Reduction reduceSumMasked(const int* data, size_t n, int mask, SimdLevel level = detectSimd()) {
+    Reduction r = { 0, false };
+    for (size_t start = 0; start < n; start += reduce_detail::BLOCK) {
+        r.value += reduce_detail::sumBlock(data + start, std::min(reduce_detail::BLOCK, n - start), mask, level);
+    }
+    return r;
+}
+
+inline Reduction reduceSum(const int* data, size_t n, SimdLevel level = detectSimd()) {
+    return reduceSumMasked(data, n, 0, level);
+}
+
+inline Reduction reduceSumSquares(const int* data, size_t n, SimdLevel level = detectSimd()) {
+    unsigned __int128 sum = 0;
+    for (size_t start = 0; start < n; start += reduce_detail::BLOCK) {
+        sum += reduce_detail::squaresBlock(data + start, std::min(reduce_detail::BLOCK, n - start), level);
+    }
+    Reduction r = { (__int128)sum, false };
+    return r;
+}
+
+// Checked 128-bit product. Multiplying stops at the first zero or overflow;
+// after an overflow the rest is only scanned for a zero, which would still
+// make the product exactly 0.
+inline Reduction reduceProduct(const int* data, size_t n, SimdLevel level = detectSimd()) {
+    Reduction r = { 1, false };
+    for (size_t i = 0; i < n; i++) {
+        if (data[i] == 0) {
+            r.value = 0;
+            return r;
+        }
+        if (__builtin_mul_overflow(r.value, (__int128)data[i], &r.value)) {
+            r.overflow = !reduce_detail::hasZero(data + i + 1, n - i - 1, level);
+            r.value = 0;
+            return r;
+        }
+    }
+    return r;
+}
+
+// Time each reduction at every SIMD level this CPU supports over count
+// values, against the plain int loops they replace
+inline void benchmarkReductions(size_t count) {
+    std::vector<int> values(count);
+    std::mt19937 rng(5);
+    for (auto& v : values) v = (int)(rng() % 2000001) - 1000000;
+    // Nonzero, so the product overflows early and the zero scan covers the rest
+    std::vector<int> factors(count);
+    for (auto& v : factors) v = 1 + (int)(rng() % 1000);
+
+    double gigabytes = count * sizeof(int) / 1e9;
+    auto measure = [&](const char* name, const char* level, auto run) {
+        run();  // warm up
+        double best = 1e300;
+        for (int rep = 0; rep < 3; rep++) {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::cout << std::setw(14) << std::left << name << std::setw(8) << level << std::right << std::fixed
+            << std::setprecision(2) << std::setw(8) << best * 1000 << " ms " << std::setw(7) << gigabytes / best << " GB/s\n";
+    };
+
+    std::cout << "reductions over " << count << " ints, detected " << simdName(detectSimd()) << "\n";
+
+    // The loops from the programs, folding into an int that wraps. Signed
+    // overflow is undefined, so the wrap is spelled out in unsigned arithmetic
+    // to keep the optimizer from reshaping the loops around it.
+    volatile int sink;
+    measure("sum", "int", [&] {
+        unsigned sum = 0;
+        for (int v : values) sum += (unsigned)v;
+        sink = (int)sum;
+    });
+    measure("even sum", "int", [&] {
+        unsigned sum = 0;
+        for (int v : values) if (v % 2 == 0) sum += (unsigned)v;
+        sink = (int)sum;
+    });
+    measure("sum squares", "int", [&] {
+        unsigned sum = 0;
+        for (int v : values) sum += (unsigned)v * (unsigned)v;
+        sink = (int)sum;
+    });
+    measure("product", "int", [&] {
+        unsigned product = 1;
+        for (int v : factors) product *= (unsigned)v;
+        sink = (int)product;
+    });
+    (void)sink;
+
+    Reduction expected[4] = {};
+    bool agree = true;
+    for (int l = SIMD_SCALAR; l <= detectSimd(); l++) {
+        SimdLevel level = (SimdLevel)l;
+        Reduction got[4];
+        measure("sum", simdName(level), [&] { got[0] = reduceSum(values.data(), count, level); });
+        measure("even sum", simdName(level), [&] { got[1] = reduceSumMasked(values.data(), count, 1, level); });
+        measure("sum squares", simdName(level), [&] { got[2] = reduceSumSquares(values.data(), count, level); });
+        measure("product", simdName(level), [&] { got[3] = reduceProduct(factors.data(), count, level); });
+        for (int k = 0; k < 4; k++) {
+            if (l == SIMD_SCALAR) expected[k] = got[k];
+            agree = agree && got[k].value == expected[k].value && got[k].overflow == expected[k].overflow;
+        }
+    }
+    std::cout << "sum " << expected[0] << ", even sum " << expected[1] << ", sum of squares " << expected[2]
+        << ", product " << expected[3] << "\n"
+        << "levels " << (agree ? "agree" : "DISAGREE") << "\n";
+}
+
+#endif
@@ -0,0 +1,143 @@
+#include "evaluator.h"
+#include <string.h>
+
+// Every window of four as cell indexes (row * COLS + col)
+static int windowCells[NUM_WINDOWS][4];
+
+// Windows each cell belongs to, and which slot of the window the cell is
+static int cellWindows[ROWS * COLS][MAX_CELL_WINDOWS];
+static int cellSlots[ROWS * COLS][MAX_CELL_WINDOWS];
+static int cellWindowCount[ROWS * COLS];
+static int tablesReady = 0;
+
+static void addWindow(int* w, int row, int col, int dr, int dc) {
+    for (int k = 0; k < 4; k++) {
+        int cell = (row + k * dr) * COLS + (col + k * dc);
+        windowCells[*w][k] = cell;
+        cellWindows[cell][cellWindowCount[cell]] = *w;
+        cellSlots[cell][cellWindowCount[cell]] = k;
+        cellWindowCount[cell]++;
+    }
+    (*w)++;
+}
+
+static void buildTables() {
+    int w = 0;
+    for (int i = 0; i < ROWS; i++) {
+        for (int j = 0; j < COLS; j++) {
+            if (j + 3 < COLS) addWindow(&w, i, j, 0, 1);
+            if (i + 3 < ROWS) addWindow(&w, i, j, 1, 0);
+            if (i + 3 < ROWS && j + 3 < COLS) addWindow(&w, i, j, 1, 1);
+            if (i + 3 < ROWS && j - 3 >= 0) addWindow(&w, i, j, 1, -1);
+        }
+    }
+    tablesReady = 1;
+}
+
+static int playerIndex(char token) {
+    return token == PLAYER_1 ? 0 : 1;
+}
+
+// Add (sign = 1) or remove (sign = -1) what one window contributes to the counts
+static void scoreWindow(Evaluator* eval, int w, int sign) {
+    for (int p = 0; p < 2; p++) {
+        int mine = eval->count[p][w];
+        int theirs = eval->count[1 - p][w];
+
+        if (mine == 4) {
+            eval->fours[p] += sign;
+        }
+        else if (mine == 3 && theirs == 0) {
+            int slot = 0;
+            while (eval->filled[w] & (1 << slot)) slot++;
+            int cell = windowCells[w][slot];
+            int rowFromBottom = ROWS - cell / COLS;
+
+            eval->threes[p] += sign;
+            eval->threats[p][rowFromBottom & 1] += sign;
+            eval->threatAt[p][cell] += sign;
+        }
+    }
+}
+
+static void updateCell(Evaluator* eval, int cell, int p, int adding) {
+    for (int k = 0; k < cellWindowCount[cell]; k++) {
+        int w = cellWindows[cell][k];
+        scoreWindow(eval, w, -1);
+        if (adding) {
+            eval->count[p][w]++;
+            eval->filled[w] |= (1 << cellSlots[cell][k]);
+        }
+        else {
+            eval->count[p][w]--;
+            eval->filled[w] &= ~(1 << cellSlots[cell][k]);
+        }
+        scoreWindow(eval, w, 1);
+    }
+}
+
+void evalReset(char board[ROWS][COLS], Evaluator* eval) {
+    if (!tablesReady) buildTables();
+
+    for (int i = 0; i < ROWS; i++) {
+        for (int j = 0; j < COLS; j++) {
+            board[i][j] = ' ';
+        }
+    }
+    memset(eval, 0, sizeof(*eval));
+}
+
+int play(char board[ROWS][COLS], Evaluator* eval, int column, char token) {
+    if (eval->heights[column] >= ROWS) return -1;
+
+    int row = ROWS - 1 - eval->heights[column];
+    board[row][column] = token;
+    eval->heights[column]++;
+    eval->moves++;
+    updateCell(eval, row * COLS + column, playerIndex(token), 1);
+    return row;
+}
+
+void undo(char board[ROWS][COLS], Evaluator* eval, int column) {
+    if (eval->heights[column] == 0) return;
+
+    int row = ROWS - eval->heights[column];
+    updateCell(eval, row * COLS + column, playerIndex(board[row][column]), 0);
+    board[row][column] = ' ';
+    eval->heights[column]--;
+    eval->moves--;
+}
+
+int immediateWins(const Evaluator* eval, char token) {
+    int p = playerIndex(token);
+    int wins = 0;
+    for (int j = 0; j < COLS; j++) {
+        if (eval->heights[j] < ROWS) {
+            int row = ROWS - 1 - eval->heights[j];
+            if (eval->threatAt[p][row * COLS + j] > 0) wins++;
+        }
+    }
+    return wins;
+}
+
+int evalScore(const Evaluator* eval, char token) {
+    int p = playerIndex(token);
+    int o = 1 - p;
+
+    if (eval->fours[p] > 0) return 100000;
+    if (eval->fours[o] > 0) return -100000;
+
+    // Player 1 profits from threats on odd rows and player 2 from even rows
+    int myParity = (p == 0) ? 1 : 0;
+    int score = 5 * (eval->threes[p] - eval->threes[o]);
+    score += 10 * (eval->threats[p][myParity] - eval->threats[o][1 - myParity]);
+    score += 1000 * (immediateWins(eval, token) - immediateWins(eval, o == 0 ? PLAYER_1 : PLAYER_2));
+    return score;
+}
+
+enum GameState gameStatus(const Evaluator* eval) {
+    if (eval->fours[0] > 0) return PLAYER_1_WINS;
+    if (eval->fours[1] > 0) return PLAYER_2_WINS;
+    if (eval->moves == ROWS * COLS) return DRAW;
+    return ONGOING;
+}
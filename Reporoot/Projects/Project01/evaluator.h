@@ -0,0 +1,43 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#define ROWS 6
+#define COLS 7
+
+#define NUM_WINDOWS 69       // 24 horizontal + 21 vertical + 24 diagonal
+#define MAX_CELL_WINDOWS 16  // most windows of four any one cell belongs to
+
+enum GameState { ONGOING, PLAYER_1_WINS, PLAYER_2_WINS, DRAW };
+enum Player { PLAYER_1 = 'X', PLAYER_2 = 'O' };
+
+// Threat counts kept up to date on every play() and undo().
+// Index 0 is PLAYER_1, index 1 is PLAYER_2.
+struct Evaluator {
+    unsigned char count[2][NUM_WINDOWS];    // tokens of each player in each window
+    unsigned char filled[NUM_WINDOWS];      // bitmask of occupied slots in each window
+    unsigned char threatAt[2][ROWS * COLS]; // open threes whose empty cell is this cell
+    int threes[2];                          // windows with three tokens and one empty cell
+    int threats[2][2];                      // open threes by row parity [even, odd], bottom row is 1
+    int fours[2];                           // completed windows of four
+    int heights[COLS];
+    int moves;
+};
+
+// Clear the board and reset all counts
+void evalReset(char board[ROWS][COLS], Evaluator* eval);
+
+// Drop a token into a column, returns the row it landed in or -1 if the column is full
+int play(char board[ROWS][COLS], Evaluator* eval, int column, char token);
+
+// Take back the top token of a column
+void undo(char board[ROWS][COLS], Evaluator* eval, int column);
+
+// Columns where the player wins by dropping a token right now
+int immediateWins(const Evaluator* eval, char token);
+
+// Heuristic score from the point of view of token, positive is good for token
+int evalScore(const Evaluator* eval, char token);
+
+enum GameState gameStatus(const Evaluator* eval);
+
+#endif
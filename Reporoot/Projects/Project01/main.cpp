@@ -1,19 +1,6 @@
 #include <iostream>
 #include <stdio.h>
-
-#define ROWS 6
-#define COLS 7
-
-enum GameState { ONGOING, PLAYER_1_WINS, PLAYER_2_WINS, DRAW };
-enum Player { PLAYER_1 = 'X', PLAYER_2 = 'O' };
-
-void makeBoard(char board[ROWS][COLS]) {
-    for (int i = 0; i < ROWS; i++) {
-        for (int j = 0; j < COLS; j++) {
-            board[i][j] = ' ';
-        }
-    }
-}
+#include "evaluator.h"
 
 void printBoard(char board[ROWS][COLS]) {
     for (int i = 0; i < ROWS; i++) {
@@ -25,19 +12,6 @@ void printBoard(char board[ROWS][COLS]) {
     printf("\n");
 }
 
-void play(char board[ROWS][COLS], int column, char token) {
-    for (int i = ROWS - 1; i >= 0; i--) {
-        if (board[i][column] == ' ') {
-            board[i][column] = token;
-            break;
-        }
-    }
-}
-
-enum GameState gameStatus(char board[ROWS][COLS]) {
-  
-}
-
 int getValidColumn(char board[ROWS][COLS]) {
     int column;
     while (1) {
@@ -66,20 +40,21 @@ int askToPlayAgain() {
 
 int main() {
     char board[ROWS][COLS];
+    Evaluator eval;
     enum GameState state;
     char currentPlayer = PLAYER_1;
 
     printRules();
 
     do {
-        makeBoard(board);
+        evalReset(board, &eval);
         state = ONGOING;
 
         while (state == ONGOING) {
             printBoard(board);
             int column = getValidColumn(board);
-            play(board, column, currentPlayer);
-            state = gameStatus(board);
+            play(board, &eval, column, currentPlayer);
+            state = gameStatus(&eval);
 
             if (state == ONGOING) {
                 currentPlayer = (currentPlayer == PLAYER_1) ? PLAYER_2 : PLAYER_1;